@@ -0,0 +1,86 @@
+#ifndef ASTARENA_H
+#define ASTARENA_H
+
+#include <llvm/Support/Allocator.h>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <utility>
+
+#include "Profile.h"
+
+class NBlock;
+
+//The nodes and child lists of one AST. They are bump allocated and never
+//destroyed one by one: nodes only hold pointers, symbols and numbers, so
+//dropping the arena frees the whole tree at once.
+class ASTArena{
+private:
+    llvm::BumpPtrAllocator allocator;
+
+public:
+    //set by the parser, nullptr for an arena of synthesized nodes
+    NBlock* root = nullptr;
+
+    ASTArena(){}
+    ~ASTArena(){
+        astArenaBytes.fetch_add(bytesAllocated(), std::memory_order_relaxed);
+    }
+    ASTArena(const ASTArena&) = delete;
+    ASTArena& operator=(const ASTArena&) = delete;
+
+    template<typename T, typename... Args>
+    T* make(Args&&... args){
+        return new (allocator.Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    template<typename T>
+    T* allocateArray(size_t count){
+        return allocator.Allocate<T>(count);
+    }
+
+    size_t bytesAllocated() const{
+        return allocator.getBytesAllocated();
+    }
+};
+
+//The children of a node, in the arena of its tree. Growing the list moves it
+//to a block twice the size and leaves the old one to the arena.
+template<typename T>
+class NodeList{
+private:
+    T** items = nullptr;
+    uint32_t count = 0;
+    uint32_t capacity = 0;
+
+public:
+    typedef T* value_type;
+    typedef T* const* const_iterator;
+
+    NodeList(){}
+
+    void push_back(ASTArena& arena, T* item){
+        if( count == capacity ){
+            capacity = capacity ? capacity * 2 : 4;
+            T** grown = arena.allocateArray<T*>(capacity);
+            if( count )
+                memcpy(grown, items, count * sizeof(T*));
+            items = grown;
+        }
+        items[count++] = item;
+    }
+
+    //for rewriters: replace an item, or drop the items from count on
+    void set(size_t index, T* item){ items[index] = item; }
+    void truncate(size_t newCount){ count = newCount < count ? newCount : count; }
+
+    const_iterator begin() const{ return items; }
+    const_iterator end() const{ return items + count; }
+    size_t size() const{ return count; }
+    bool empty() const{ return count == 0; }
+    T* operator[](size_t index) const{ return items[index]; }
+    T* back() const{ return items[count - 1]; }
+};
+
+#endif //ASTARENA_H
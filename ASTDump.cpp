@@ -0,0 +1,107 @@
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/Support/Format.h>
+
+#include "ASTDump.h"
+#include "ASTVisitor.h"
+#include "FastLexer.h"
+
+using namespace llvm;
+
+namespace {
+
+class ASTDumper{
+private:
+    raw_ostream& out;
+    ASTDumpFormat style;
+    //one entry per open node: whether a child of it was written yet
+    SmallVector<bool, 32> open;
+
+    void writeJsonString(StringRef text){
+        for(char c: text){
+            if( c == '"' || c == '\\' )
+                out << '\\' << c;
+            else if( (unsigned char)c < 0x20 )
+                out << format("\\u%04x", c);
+            else
+                out << c;
+        }
+    }
+
+    //The text after the class name, empty for nodes that only have children
+    static void describe(const Node* node, SmallString<64>& detail){
+        raw_svector_ostream text(detail);
+        if( auto integer = dyn_cast<NInteger>(node) ){
+            text << integer->value;
+        }else if( auto number = dyn_cast<NDouble>(node) ){
+            text << format("%g", number->value);
+        }else if( auto identifier = dyn_cast<NIdentifier>(node) ){
+            text << identifier->name.str() << (identifier->isArray ? "(Array)" : "");
+        }else if( auto binary = dyn_cast<NBinaryOperator>(node) ){
+            text << tokenName(binary->op);
+        }else if( auto declaration = dyn_cast<NStructDeclaration>(node) ){
+            text << declaration->name->name.str();
+        }else if( auto literal = dyn_cast<NLiteral>(node) ){
+            text << '"' << literal->value << '"';
+        }else if( auto function = dyn_cast<NFunctionDeclaration>(node) ){
+            if( function->isExternal )
+                text << "extern";
+            if( function->isVariadic )
+                text << " ...";
+        }else if( auto loop = dyn_cast<NForStatement>(node) ){
+            loop->hints.print(text);
+        }
+    }
+
+    void begin(const Node* node){
+        SmallString<64> detail;
+        describe(node, detail);
+        if( style == ASTDumpFormat::Text ){
+            out.indent(open.size() * 2) << nodeKindName(node->getKind());
+            if( !detail.empty() )
+                out << ' ' << detail;
+            out << '\n';
+        }else{
+            if( !open.empty() ){
+                out << (open.back() ? "," : ",\"children\":[");
+                open.back() = true;
+            }
+            out << "{\"name\":\"" << nodeKindName(node->getKind());
+            if( !detail.empty() ){
+                out << ':';
+                writeJsonString(detail);
+            }
+            out << '"';
+        }
+        open.push_back(false);
+    }
+
+    void end(){
+        if( style == ASTDumpFormat::Json )
+            out << (open.back() ? "]}" : "}");
+        open.pop_back();
+    }
+
+public:
+    ASTDumper(raw_ostream& out, ASTDumpFormat format)
+        : out(out), style(format){}
+
+    //Absent optional children (no else block, no initializer) are skipped
+    void dump(const Node* node){
+        begin(node);
+        forEachChild(node, [this](Node* child){
+            dump(child);
+        });
+        end();
+    }
+};
+
+}
+
+void dumpAST(const Node& node, ASTDumpFormat format, raw_ostream& out){
+    if( format == ASTDumpFormat::None )
+        return;
+    ASTDumper(out, format).dump(&node);
+    if( format == ASTDumpFormat::Json )
+        out << '\n';
+}
@@ -0,0 +1,21 @@
+#ifndef ASTDUMP_H
+#define ASTDUMP_H
+
+#include <llvm/Support/raw_ostream.h>
+
+#include "ASTNodes.h"
+#include "Options.h"
+
+//Write the tree under node to out while walking it once. Nothing but the
+//path from the root to the current node is kept, so the memory used does
+//not grow with the size of the program.
+//
+//Text gives one line per node, indented two spaces per level:
+//    NBinaryOperator TPLUS
+//      NIdentifier i
+//      NInteger 1
+//Json gives {"name": "NBinaryOperator:TPLUS", "children": [...]} objects,
+//the shape jsonGen() used to build in memory.
+void dumpAST(const Node& node, ASTDumpFormat format, llvm::raw_ostream& out);
+
+#endif //ASTDUMP_H
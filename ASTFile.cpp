@@ -0,0 +1,580 @@
+#include <llvm/ADT/DenseMap.h>
+
+#include <string.h>
+#include <vector>
+
+#include "ASTFile.h"
+#include "Parser.h"
+#include "Profile.h"
+
+using namespace llvm;
+
+static const char astMagic[8] = {'S', 'U', 'B', 'C', 'A', 'S', 'T', '\0'};
+//written as is, reads back differently on a machine of the other byte order
+static const uint32_t byteOrderMark = 0x01020304;
+
+namespace {
+
+struct FileHeader{
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t nodeCount;
+    uint32_t listCount;
+    uint32_t symbolCount;
+    uint32_t stringBytes;
+    //reference of the NBlock at the top
+    uint32_t root;
+    uint32_t reserved;
+};
+static_assert(sizeof(FileHeader) == 40, "the node records follow 8 byte aligned");
+
+//One node. What the fields hold depends on the kind, see ASTWriter::add;
+//lists and strings are (offset << 32 | count) in payload. A loop keeps its
+//body in the low half of payload and its LoopHints in flags, reserved and
+//the high half.
+struct NodeRecord{
+    uint8_t kind;
+    uint8_t flags;
+    uint16_t reserved;
+    uint32_t child[3];
+    uint64_t payload;
+};
+static_assert(sizeof(NodeRecord) == 24, "records are read in place");
+
+struct SymbolRecord{
+    uint32_t offset;
+    uint32_t length;
+};
+
+enum RecordFlags : uint8_t{
+    IsType = 1,
+    IsArray = 2,
+    IsExternal = 1,
+    IsVariadic = 2,
+};
+
+class ASTWriter{
+private:
+    std::vector<NodeRecord> nodes;
+    std::vector<uint32_t> lists;
+    std::vector<SymbolRecord> symbols;
+    std::string strings;
+    //nodes reachable twice are written once
+    DenseMap<const Node*, uint32_t> written;
+    DenseMap<const void*, uint32_t> symbolIndex;
+
+    static uint64_t span(uint64_t offset, uint64_t count){
+        return offset << 32 | count;
+    }
+
+    uint32_t addSymbol(Symbol symbol){
+        if( symbol.empty() )
+            return 0;
+        auto found = symbolIndex.find(symbol.opaque());
+        if( found != symbolIndex.end() )
+            return found->second;
+        StringRef text = symbol.str();
+        symbols.push_back(SymbolRecord{(uint32_t)strings.size(), (uint32_t)text.size()});
+        strings.append(text.data(), text.size());
+        return symbolIndex[symbol.opaque()] = symbols.size();
+    }
+
+    uint64_t addString(StringRef text){
+        uint64_t offset = strings.size();
+        strings.append(text.data(), text.size());
+        return span(offset, text.size());
+    }
+
+    template<typename T>
+    uint64_t addList(const NodeList<T>& list){
+        //the children go first, their references then sit side by side
+        SmallVector<uint32_t, 8> references;
+        for(auto item: list){
+            references.push_back(add(item));
+        }
+        uint64_t offset = lists.size();
+        lists.insert(lists.end(), references.begin(), references.end());
+        return span(offset, references.size());
+    }
+
+public:
+    uint32_t add(const Node* node){
+        if( node == nullptr )
+            return 0;
+        auto found = written.find(node);
+        if( found != written.end() )
+            return found->second;
+
+        NodeRecord record = {};
+        record.kind = (uint8_t)node->getKind();
+        switch( node->getKind() ){
+        case NodeKind::Integer:
+            record.payload = cast<NInteger>(node)->value;
+            break;
+        case NodeKind::Double:
+            memcpy(&record.payload, &cast<NDouble>(node)->value, sizeof(double));
+            break;
+        case NodeKind::Identifier:{
+            auto identifier = cast<NIdentifier>(node);
+            record.child[0] = addSymbol(identifier->name);
+            record.flags = (identifier->isType ? IsType : 0) | (identifier->isArray ? IsArray : 0);
+            record.payload = addList(identifier->arraySize);
+            break;
+        }
+        case NodeKind::Literal:
+            record.payload = addString(cast<NLiteral>(node)->value);
+            break;
+        case NodeKind::MethodCall:{
+            auto call = cast<NMethodCall>(node);
+            record.child[0] = add(call->id);
+            record.payload = addList(call->arguments);
+            break;
+        }
+        case NodeKind::BinaryOperator:{
+            auto binary = cast<NBinaryOperator>(node);
+            record.child[0] = add(binary->lhs);
+            record.child[1] = add(binary->rhs);
+            record.child[2] = binary->op;
+            break;
+        }
+        case NodeKind::Assignment:{
+            auto assignment = cast<NAssignment>(node);
+            record.child[0] = add(assignment->lhs);
+            record.child[1] = add(assignment->rhs);
+            break;
+        }
+        case NodeKind::Block:
+            record.payload = addList(cast<NBlock>(node)->statements);
+            break;
+        case NodeKind::StructMember:{
+            auto member = cast<NStructMember>(node);
+            record.child[0] = add(member->id);
+            record.child[1] = add(member->member);
+            break;
+        }
+        case NodeKind::ArrayIndex:{
+            auto index = cast<NArrayIndex>(node);
+            record.child[0] = add(index->arrayName);
+            record.payload = addList(index->expressions);
+            break;
+        }
+        case NodeKind::ArrayAssignment:{
+            auto assignment = cast<NArrayAssignment>(node);
+            record.child[0] = add(assignment->arrayIndex);
+            record.child[1] = add(assignment->expression);
+            break;
+        }
+        case NodeKind::StructAssignment:{
+            auto assignment = cast<NStructAssignment>(node);
+            record.child[0] = add(assignment->structMember);
+            record.child[1] = add(assignment->expression);
+            break;
+        }
+        case NodeKind::ExpressionStatement:
+            record.child[0] = add(cast<NExpressionStatement>(node)->expression);
+            break;
+        case NodeKind::VariableDeclaration:{
+            auto declaration = cast<NVariableDeclaration>(node);
+            record.child[0] = add(declaration->type);
+            record.child[1] = add(declaration->id);
+            record.child[2] = add(declaration->assignmentExpr);
+            break;
+        }
+        case NodeKind::FunctionDeclaration:{
+            auto function = cast<NFunctionDeclaration>(node);
+            record.child[0] = add(function->type);
+            record.child[1] = add(function->id);
+            record.child[2] = add(function->block);
+            record.flags = (function->isExternal ? IsExternal : 0) | (function->isVariadic ? IsVariadic : 0);
+            record.payload = addList(function->arguments);
+            break;
+        }
+        case NodeKind::StructDeclaration:{
+            auto declaration = cast<NStructDeclaration>(node);
+            record.child[0] = add(declaration->name);
+            record.payload = addList(declaration->members);
+            break;
+        }
+        case NodeKind::ReturnStatement:
+            record.child[0] = add(cast<NReturnStatement>(node)->expression);
+            break;
+        case NodeKind::IfStatement:{
+            auto ifStatement = cast<NIfStatement>(node);
+            record.child[0] = add(ifStatement->condition);
+            record.child[1] = add(ifStatement->trueBlock);
+            record.child[2] = add(ifStatement->falseBlock);
+            break;
+        }
+        case NodeKind::ForStatement:{
+            auto forStatement = cast<NForStatement>(node);
+            record.child[0] = add(forStatement->initial);
+            record.child[1] = add(forStatement->condition);
+            record.child[2] = add(forStatement->increment);
+            record.payload = add(forStatement->block);
+            record.flags = forStatement->hints.flags;
+            record.reserved = forStatement->hints.vectorizeWidth;
+            record.payload |= (uint64_t)forStatement->hints.interleaveCount << 48 | (uint64_t)forStatement->hints.unrollCount << 32;
+            break;
+        }
+        case NodeKind::ArrayInitialization:{
+            auto initialization = cast<NArrayInitialization>(node);
+            record.child[0] = add(initialization->declaration);
+            record.payload = addList(initialization->expressionList);
+            break;
+        }
+        default:
+            break;
+        }
+
+        nodes.push_back(record);
+        return written[node] = nodes.size();
+    }
+
+    void write(raw_ostream& out, uint32_t root){
+        FileHeader header = {};
+        memcpy(header.magic, astMagic, sizeof(astMagic));
+        header.version = astFileVersion;
+        header.byteOrder = byteOrderMark;
+        header.nodeCount = nodes.size();
+        header.listCount = lists.size();
+        header.symbolCount = symbols.size();
+        header.stringBytes = strings.size();
+        header.root = root;
+        out.write((const char*)&header, sizeof(header));
+        out.write((const char*)nodes.data(), nodes.size() * sizeof(NodeRecord));
+        out.write((const char*)lists.data(), lists.size() * sizeof(uint32_t));
+        out.write((const char*)symbols.data(), symbols.size() * sizeof(SymbolRecord));
+        out.write(strings.data(), strings.size());
+    }
+};
+
+//Builds the nodes of the records in file order. A reference may only name an
+//earlier record, so every child exists before its parent and the references
+//cannot form a cycle.
+class ASTReader{
+private:
+    ASTArena& arena;
+    const NodeRecord* records;
+    const uint32_t* lists;
+    uint32_t listCount;
+    const char* strings;
+    uint32_t stringBytes;
+    std::vector<Symbol> symbols;
+    std::vector<Node*> nodes;
+    std::string& error;
+
+    Node* invalid(const char* message){
+        if( error.empty() )
+            error = "malformed AST file: " + std::string(message) + " in node " + std::to_string(nodes.size());
+        return nullptr;
+    }
+
+    bool failed() const{
+        return !error.empty();
+    }
+
+    template<typename T>
+    T* child(uint32_t reference, bool optional = false){
+        if( reference == 0 ){
+            if( !optional )
+                invalid("missing child");
+            return nullptr;
+        }
+        if( reference > nodes.size() ){
+            invalid("reference to a later node");
+            return nullptr;
+        }
+        T* result = dyn_cast<T>(nodes[reference - 1]);
+        if( !result )
+            invalid("child of the wrong kind");
+        return result;
+    }
+
+    template<typename T>
+    NodeList<T> list(uint64_t payload){
+        uint64_t offset = payload >> 32;
+        uint64_t count = (uint32_t)payload;
+        NodeList<T> result;
+        if( offset + count > listCount ){
+            invalid("list out of bounds");
+            return result;
+        }
+        for(uint64_t i=0; i<count && !failed(); i++){
+            result.push_back(arena, child<T>(lists[offset + i]));
+        }
+        return result;
+    }
+
+    Symbol symbol(uint32_t reference){
+        if( reference > symbols.size() ){
+            invalid("symbol out of bounds");
+            return Symbol();
+        }
+        return reference ? symbols[reference - 1] : Symbol();
+    }
+
+    Node* build(const NodeRecord& record){
+        switch( (NodeKind)record.kind ){
+        case NodeKind::Integer:
+            return arena.make<NInteger>(record.payload);
+        case NodeKind::Double:{
+            double value;
+            memcpy(&value, &record.payload, sizeof(double));
+            return arena.make<NDouble>(value);
+        }
+        case NodeKind::Identifier:{
+            auto identifier = arena.make<NIdentifier>(symbol(record.child[0]));
+            identifier->isType = record.flags & IsType;
+            identifier->isArray = record.flags & IsArray;
+            identifier->arraySize = list<NExpression>(record.payload);
+            if( failed() )
+                return nullptr;
+            //the parser only writes integer dimensions, TypeSystem casts to them
+            for(auto size: identifier->arraySize){
+                if( !isa<NInteger>(size) )
+                    return invalid("array dimension is not an integer");
+            }
+            return identifier;
+        }
+        case NodeKind::Literal:{
+            uint64_t offset = record.payload >> 32;
+            uint64_t length = (uint32_t)record.payload;
+            if( offset + length > stringBytes )
+                return invalid("literal out of bounds");
+            return arena.make<NLiteral>(StringRef(strings + offset, length));
+        }
+        case NodeKind::MethodCall:{
+            auto id = child<NIdentifier>(record.child[0]);
+            auto arguments = list<NExpression>(record.payload);
+            if( failed() )
+                return nullptr;
+            return arena.make<NMethodCall>(id, arguments);
+        }
+        case NodeKind::BinaryOperator:{
+            auto lhs = child<NExpression>(record.child[0]);
+            auto rhs = child<NExpression>(record.child[1]);
+            if( failed() )
+                return nullptr;
+            return arena.make<NBinaryOperator>(lhs, (int)record.child[2], rhs);
+        }
+        case NodeKind::Assignment:{
+            auto lhs = child<NIdentifier>(record.child[0]);
+            auto rhs = child<NExpression>(record.child[1]);
+            if( failed() )
+                return nullptr;
+            return arena.make<NAssignment>(lhs, rhs);
+        }
+        case NodeKind::Block:{
+            auto block = arena.make<NBlock>();
+            block->statements = list<NStatement>(record.payload);
+            return block;
+        }
+        case NodeKind::StructMember:{
+            auto id = child<NIdentifier>(record.child[0]);
+            auto member = child<NIdentifier>(record.child[1]);
+            if( failed() )
+                return nullptr;
+            return arena.make<NStructMember>(id, member);
+        }
+        case NodeKind::ArrayIndex:{
+            auto name = child<NIdentifier>(record.child[0]);
+            auto expressions = list<NExpression>(record.payload);
+            if( failed() )
+                return nullptr;
+            return arena.make<NArrayIndex>(name, expressions);
+        }
+        case NodeKind::ArrayAssignment:{
+            auto index = child<NArrayIndex>(record.child[0]);
+            auto expression = child<NExpression>(record.child[1]);
+            if( failed() )
+                return nullptr;
+            return arena.make<NArrayAssignment>(index, expression);
+        }
+        case NodeKind::StructAssignment:{
+            auto member = child<NStructMember>(record.child[0]);
+            auto expression = child<NExpression>(record.child[1]);
+            if( failed() )
+                return nullptr;
+            return arena.make<NStructAssignment>(member, expression);
+        }
+        case NodeKind::ExpressionStatement:{
+            auto expression = child<NExpression>(record.child[0]);
+            if( failed() )
+                return nullptr;
+            return arena.make<NExpressionStatement>(expression);
+        }
+        case NodeKind::VariableDeclaration:{
+            auto type = child<NIdentifier>(record.child[0]);
+            auto id = child<NIdentifier>(record.child[1]);
+            auto initial = child<NExpression>(record.child[2], true);
+            if( failed() )
+                return nullptr;
+            //what the constructor asserts
+            if( !type->isType || (type->isArray && type->arraySize.empty()) )
+                return invalid("declaration of a non-type");
+            return arena.make<NVariableDeclaration>(type, id, initial);
+        }
+        case NodeKind::FunctionDeclaration:{
+            auto type = child<NIdentifier>(record.child[0]);
+            auto id = child<NIdentifier>(record.child[1]);
+            bool isExternal = record.flags & IsExternal;
+            bool isVariadic = record.flags & IsVariadic;
+            auto block = child<NBlock>(record.child[2], isExternal);
+            auto arguments = list<NVariableDeclaration>(record.payload);
+            if( failed() )
+                return nullptr;
+            if( !type->isType )
+                return invalid("function of a non-type");
+            //what the grammar allows
+            if( isVariadic && (!isExternal || arguments.empty()) )
+                return invalid("variadic function that is not an extern with parameters");
+            return arena.make<NFunctionDeclaration>(type, id, arguments, block, isExternal, isVariadic);
+        }
+        case NodeKind::StructDeclaration:{
+            auto name = child<NIdentifier>(record.child[0]);
+            auto members = list<NVariableDeclaration>(record.payload);
+            if( failed() )
+                return nullptr;
+            return arena.make<NStructDeclaration>(name, members);
+        }
+        case NodeKind::ReturnStatement:{
+            auto expression = child<NExpression>(record.child[0], true);
+            if( failed() )
+                return nullptr;
+            return arena.make<NReturnStatement>(expression);
+        }
+        case NodeKind::IfStatement:{
+            auto condition = child<NExpression>(record.child[0]);
+            auto trueBlock = child<NBlock>(record.child[1]);
+            auto falseBlock = child<NBlock>(record.child[2], true);
+            if( failed() )
+                return nullptr;
+            return arena.make<NIfStatement>(condition, trueBlock, falseBlock);
+        }
+        case NodeKind::ForStatement:{
+            auto initial = child<NExpression>(record.child[0], true);
+            auto condition = child<NExpression>(record.child[1]);
+            auto increment = child<NExpression>(record.child[2], true);
+            auto block = child<NBlock>((uint32_t)record.payload);
+            if( failed() )
+                return nullptr;
+            if( !block )
+                return invalid("loop without a body");
+            if( record.flags & ~LoopHints::AllFlags )
+                return invalid("unknown loop hint");
+            auto loop = arena.make<NForStatement>(block, initial, condition, increment);
+            loop->hints.flags = record.flags;
+            loop->hints.vectorizeWidth = record.reserved;
+            loop->hints.interleaveCount = record.payload >> 48;
+            loop->hints.unrollCount = (uint16_t)(record.payload >> 32);
+            return loop;
+        }
+        case NodeKind::ArrayInitialization:{
+            auto declaration = child<NVariableDeclaration>(record.child[0]);
+            auto expressions = list<NExpression>(record.payload);
+            if( failed() )
+                return nullptr;
+            return arena.make<NArrayInitialization>(declaration, expressions);
+        }
+        default:
+            return invalid("unknown node kind");
+        }
+    }
+
+public:
+    ASTReader(ASTArena& arena, std::string& error)
+        : arena(arena), error(error){}
+
+    NBlock* read(const SourceBuffer& source){
+        const char* data = source.data();
+        uint64_t size = source.size();
+        if( size < sizeof(FileHeader) ){
+            error = "truncated AST file";
+            return nullptr;
+        }
+        const FileHeader& header = *(const FileHeader*)data;
+        if( header.byteOrder != byteOrderMark ){
+            error = "AST file written on a machine of the other byte order";
+            return nullptr;
+        }
+        if( header.version != astFileVersion ){
+            error = "AST file of version " + std::to_string(header.version) +
+                    ", this compiler reads version " + std::to_string(astFileVersion);
+            return nullptr;
+        }
+
+        uint64_t nodesAt = sizeof(FileHeader);
+        uint64_t listsAt = nodesAt + (uint64_t)header.nodeCount * sizeof(NodeRecord);
+        uint64_t symbolsAt = listsAt + (uint64_t)header.listCount * sizeof(uint32_t);
+        uint64_t stringsAt = symbolsAt + (uint64_t)header.symbolCount * sizeof(SymbolRecord);
+        if( stringsAt + header.stringBytes > size ){
+            error = "truncated AST file";
+            return nullptr;
+        }
+        records = (const NodeRecord*)(data + nodesAt);
+        lists = (const uint32_t*)(data + listsAt);
+        listCount = header.listCount;
+        strings = data + stringsAt;
+        stringBytes = header.stringBytes;
+
+        //every distinct name is interned once, the identifiers then only index them
+        const SymbolRecord* symbolRecords = (const SymbolRecord*)(data + symbolsAt);
+        symbols.reserve(header.symbolCount);
+        for(uint32_t i=0; i<header.symbolCount; i++){
+            const SymbolRecord& record = symbolRecords[i];
+            if( (uint64_t)record.offset + record.length > stringBytes ){
+                error = "malformed AST file: symbol " + std::to_string(i) + " out of bounds";
+                return nullptr;
+            }
+            symbols.push_back(intern(StringRef(strings + record.offset, record.length)));
+        }
+
+        nodes.reserve(header.nodeCount);
+        for(uint32_t i=0; i<header.nodeCount; i++){
+            Node* node = build(records[i]);
+            if( failed() )
+                return nullptr;
+            nodes.push_back(node);
+        }
+        NBlock* root = child<NBlock>(header.root);
+        return failed() ? nullptr : root;
+    }
+};
+
+}
+
+bool isASTFile(const SourceBuffer& source){
+    return source.size() >= sizeof(astMagic) && memcmp(source.data(), astMagic, sizeof(astMagic)) == 0;
+}
+
+void writeASTFile(const NBlock& root, raw_ostream& out){
+    PhaseTimer timer("write ast");
+    ASTWriter writer;
+    uint32_t reference = writer.add(&root);
+    writer.write(out, reference);
+}
+
+std::unique_ptr<ASTArena> readASTFile(SourceBuffer& source, std::string& error){
+    PhaseTimer timer("load ast");
+    std::unique_ptr<ASTArena> arena(new ASTArena());
+    ASTReader reader(*arena, error);
+    arena->root = reader.read(source);
+    if( !arena->root )
+        return nullptr;
+    return arena;
+}
+
+std::unique_ptr<ASTArena> loadProgram(SourceBuffer& source, LexerKind lexer, std::string& error){
+    if( isASTFile(source) )
+        return readASTFile(source, error);
+
+    std::unique_ptr<ASTArena> tree;
+    {
+        PhaseTimer timer("parse");
+        tree = parseBuffer(source, lexer);
+    }
+    if( !tree )
+        error = "syntax error";
+    return tree;
+}
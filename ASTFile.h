@@ -0,0 +1,38 @@
+#ifndef ASTFILE_H
+#define ASTFILE_H
+
+#include <llvm/Support/raw_ostream.h>
+
+#include <memory>
+#include <string>
+
+#include "ASTNodes.h"
+#include "Options.h"
+#include "SourceBuffer.h"
+
+//The binary AST written by -emit-ast. A header, a table of fixed size node
+//records in post order (children before their parent, the root last), the
+//child lists as arrays of node references, the interned symbols and the
+//string bytes. Node references are record index + 1, 0 is no node.
+//
+//Loading maps the file and makes one pass over the records, building each
+//node from its record with no text to scan. Operators are stored as grammar.y
+//token numbers, so the version goes up whenever those or the layout change.
+static const uint32_t astFileVersion = 3;
+
+//Whether source starts with the magic of a binary AST
+bool isASTFile(const SourceBuffer& source);
+
+//Write the tree under root in the binary AST format
+void writeASTFile(const NBlock& root, llvm::raw_ostream& out);
+
+//Build the tree stored in source. Returns nullptr and sets error when the file
+//is truncated, of another version or byte order, or its references do not
+//form a tree. The literals of the AST point into source, it has to outlive the arena.
+std::unique_ptr<ASTArena> readASTFile(SourceBuffer& source, std::string& error);
+
+//The front end for one input: a binary AST is loaded, anything else parsed
+//with lexer. Returns nullptr and sets error when neither works.
+std::unique_ptr<ASTArena> loadProgram(SourceBuffer& source, LexerKind lexer, std::string& error);
+
+#endif //ASTFILE_H
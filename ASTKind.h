@@ -0,0 +1,50 @@
+#ifndef ASTKIND_H
+#define ASTKIND_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+//The tag of every AST node, tested by isa<>/dyn_cast<> and counted for
+//-fmem-report. Expressions and statements each form one range.
+enum class NodeKind : uint8_t{
+    Double,
+    Integer,
+    Identifier,
+    MethodCall,
+    BinaryOperator,
+    Assignment,
+    Block,
+    StructMember,
+    ArrayIndex,
+    ArrayAssignment,
+    StructAssignment,
+    Literal,
+    FirstExpression = Double,
+    LastExpression = Literal,
+
+    ExpressionStatement,
+    VariableDeclaration,
+    FunctionDeclaration,
+    StructDeclaration,
+    ReturnStatement,
+    IfStatement,
+    ForStatement,
+    ArrayInitialization,
+    FirstStatement = ExpressionStatement,
+    LastStatement = ArrayInitialization,
+
+    Count
+};
+
+//Class name of a kind ("NInteger")
+inline const char* nodeKindName(NodeKind kind){
+    static const char* const names[(size_t)NodeKind::Count] = {
+        "NDouble", "NInteger", "NIdentifier", "NMethodCall", "NBinaryOperator", "NAssignment",
+        "NBlock", "NStructMember", "NArrayIndex", "NArrayAssignment", "NStructAssignment", "NLiteral",
+        "NExpressionStatement", "NVariableDeclaration", "NFunctionDeclaration", "NStructDeclaration",
+        "NReturnStatement", "NIfStatement", "NForStatement", "NArrayInitialization",
+    };
+    return names[(size_t)kind];
+}
+
+#endif //ASTKIND_H
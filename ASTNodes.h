@@ -1,14 +1,17 @@
 #ifndef ASTNODES_H
 #define ASTNODES_H
-//#define PRINT_AND_JOSONGEN
-//#define PRINT_VALID_NODE_NUM
 #include <llvm/IR/Value.h>
-#include <json/json.h>
+#include <llvm/Support/Casting.h>
 #include <iostream>
 #include <vector>
 #include <memory>
 #include <string>
 #include <stdint.h>
+#include "ASTArena.h"
+#include "ASTKind.h"
+#include "LoopHints.h"
+#include "Profile.h"
+#include "Symbol.h"
 
 class CodeGenContext;
 class NBlock;
@@ -22,77 +25,49 @@ using std::string;
 using std::shared_ptr;
 using std::make_shared;
 
-typedef std::vector<shared_ptr<NStatement>> StatementList;
-typedef std::vector<shared_ptr<NExpression>> ExpressionList;
-typedef std::vector<shared_ptr<NVariableDeclaration>> VariableList;
-
-static uint64_t nodeCount=0;
-static uint64_t intCount=0;
-static uint64_t doubleCount=0;
-static uint64_t methodCount=0;
-static uint64_t exprCount=0;
-static uint64_t blockCount=0;
+//Nodes and lists live in the ASTArena of their tree, children are plain pointers
+typedef NodeList<NStatement> StatementList;
+typedef NodeList<NExpression> ExpressionList;
+typedef NodeList<NVariableDeclaration> VariableList;
 
+//Nodes carry their kind instead of relying on RTTI, test them with
+//isa<>/dyn_cast<> from llvm/Support/Casting.h
 class Node {
-protected:
-	const char m_DELIM = ':';
-	const char* m_PREFIX = "----";
+private:
+    const NodeKind kind;
 public:
-    Node(){
-        ++nodeCount;
-#ifdef PRINT_AND_JOSONGEN       
-        std::cout<<nodeCount<<std::endl;
-#endif
+    Node(NodeKind kind) : kind(kind){
+        countNode(kind);
+    }
+    Node(const Node& other) : kind(other.kind){
+        countNode(kind);
     }
 	virtual ~Node() {}
-	virtual std::string getTypeName() const = 0;	
+
+    NodeKind getKind() const{
+        return kind;
+    }
 	virtual llvm::Value *codeGen(CodeGenContext &context) { return (llvm::Value *)0; }
-#ifdef PRINT_AND_JOSONGEN
-    virtual void print(std::string prefix) const{}
-	virtual Json::Value jsonGen() const { return Json::Value(); }
-#endif
 
 };
 
 
 class NStatement : public Node {
 public:
-    NStatement(){}
+    NStatement(NodeKind kind) : Node(kind){}
 
-	std::string getTypeName() const override {
-		return "NStatement";
+	static bool classof(const Node* node){
+		return node->getKind() >= NodeKind::FirstStatement && node->getKind() <= NodeKind::LastStatement;
 	}
-#ifdef PRINT_AND_JOSONGEN
-    virtual void print(std::string prefix) const override{
-        std::cout << prefix << getTypeName() << std::endl;
-    }
-
-    Json::Value jsonGen() const override {
-        Json::Value root;
-        root["name"] = getTypeName();
-        return root;
-    }
-#endif
 };
 
 class NExpression : public Node {
 public:
-    NExpression(){}
+    NExpression(NodeKind kind) : Node(kind){}
 
-	std::string getTypeName() const override {
-		return "NExpression";
+	static bool classof(const Node* node){
+		return node->getKind() >= NodeKind::FirstExpression && node->getKind() <= NodeKind::LastExpression;
 	}
-#ifdef PRINT_AND_JOSONGEN
-    virtual void print(std::string prefix) const override{
-        std::cout << prefix << getTypeName() << std::endl;
-    }
-
-    Json::Value jsonGen() const override {
-        Json::Value root;
-        root["name"] = getTypeName();
-        return root;
-    }
-#endif
 
 };
 
@@ -101,64 +76,34 @@ public:
 class NDouble : public NExpression {
 public:
 	double value;
-    uint64_t index;
 
-    NDouble(){++doubleCount;}
+    NDouble() : NExpression(NodeKind::Double){}
 
 	NDouble(double value)
-		: value(value) {
-            ++doubleCount;
+		: NExpression(NodeKind::Double), value(value) {
 	}
 
-	std::string getTypeName() const override {
-#ifdef GET_TYPE_NAME
-		return "NDouble";
-#else
-        return "";
-#endif
-	}
-#ifdef PRINT_AND_JOSONGEN
-	void print(std::string prefix) const override{
-		cout << prefix << getTypeName() << this->m_DELIM << value << endl;
+	static bool classof(const Node* node){
+		return node->getKind() == NodeKind::Double;
 	}
 
-    Json::Value jsonGen() const override {
-        Json::Value root;
-        root["name"] = getTypeName() + this->m_DELIM + std::to_string(value);
-        return root;
-    }
-#endif
-
 	virtual llvm::Value* codeGen(CodeGenContext&) override ;
 };
 
 class NInteger : public NExpression {
 public:
     uint64_t value;
-    uint64_t index;
 
-    NInteger(){++intCount;}
+    NInteger() : NExpression(NodeKind::Integer){}
 
     NInteger(uint64_t value)
-            : value(value) {
-                ++intCount;
+            : NExpression(NodeKind::Integer), value(value) {
     }
 
-    std::string getTypeName() const override {
-        return "NInteger";
-    }
-#ifdef PRINT_AND_JOSONGEN
-    void print(std::string prefix) const override{
-        cout << prefix << getTypeName() << this->m_DELIM << value << endl;
+    static bool classof(const Node* node){
+        return node->getKind() == NodeKind::Integer;
     }
 
-    Json::Value jsonGen() const override {
-        Json::Value root;
-        root["name"] = getTypeName() + this->m_DELIM + std::to_string(value);
-        return root;
-    }
-#endif
-
     operator NDouble(){
         return NDouble(value);
     }
@@ -168,399 +113,193 @@ public:
 
 class NIdentifier : public NExpression {
 public:
-	std::string name;
+	Symbol name = Symbol();
     bool isType = false;
     bool isArray = false;
 
-    std::shared_ptr<ExpressionList> arraySize = std::make_shared<ExpressionList>();
+    ExpressionList arraySize;
 
-    NIdentifier(){++exprCount;}
+    NIdentifier() : NExpression(NodeKind::Identifier){}
 
-	NIdentifier(const std::string &name)
-		: name(name) {
-            ++exprCount;
+	NIdentifier(Symbol name)
+		: NExpression(NodeKind::Identifier), name(name) {
 	}
 
-	std::string getTypeName() const override {
-		return "NIdentifier";
+	static bool classof(const Node* node){
+		return node->getKind() == NodeKind::Identifier;
 	}
-#ifdef PRINT_AND_JOSONGEN
-    Json::Value jsonGen() const override {
-        Json::Value root;
-        root["name"] = getTypeName() + this->m_DELIM + name + (isArray ? "(Array)" : "");
-        for(auto it=arraySize->begin(); it!=arraySize->end(); it++){
-            root["children"].append((*it)->jsonGen());
-        }
-        return root;
-    }
-
-	void print(std::string prefix) const override{
-        std::string nextPrefix = prefix+this->m_PREFIX;
-		cout << prefix << getTypeName() << this->m_DELIM << name << (isArray ? "(Array)" : "") << endl;
-        if( isArray && arraySize->size() > 0 ){
-//            assert(arraySize != nullptr);
-            for(auto it=arraySize->begin(); it!=arraySize->end(); it++){
-                (*it)->print(nextPrefix);
-            }
-        }
-	}
-#endif
 	virtual llvm::Value* codeGen(CodeGenContext&) override ;
 };
 
 class NMethodCall: public NExpression {
 public:
-	const shared_ptr<NIdentifier> id;
-	shared_ptr<ExpressionList> arguments = make_shared<ExpressionList>();
+	NIdentifier* id = nullptr;
+	ExpressionList arguments;
 
-    NMethodCall(){
-        ++methodCount;
+    NMethodCall() : NExpression(NodeKind::MethodCall){
     }
 
-	NMethodCall(const shared_ptr<NIdentifier> id, shared_ptr<ExpressionList> arguments)
-		: id(id), arguments(arguments) {
-            ++methodCount;
+	NMethodCall(NIdentifier* id, const ExpressionList& arguments)
+		: NExpression(NodeKind::MethodCall), id(id), arguments(arguments) {
 	}
 
-	NMethodCall(const shared_ptr<NIdentifier> id)
-		: id(id) {
-            ++methodCount;
+	NMethodCall(NIdentifier* id)
+		: NExpression(NodeKind::MethodCall), id(id) {
 	}
 
-	std::string getTypeName() const override {
-		return "NMethodCall";
+	static bool classof(const Node* node){
+		return node->getKind() == NodeKind::MethodCall;
 	}
-#ifdef PRINT_AND_JOSONGEN
-    Json::Value jsonGen() const override {
-        Json::Value root;
-        root["name"] = getTypeName();
-        root["children"].append(this->id->jsonGen());
-        for(auto it=arguments->begin(); it!=arguments->end(); it++){
-            root["children"].append((*it)->jsonGen());
-        }
-        return root;
-    }
-
-	void print(std::string prefix) const override{
-		std::string nextPrefix = prefix+this->m_PREFIX;
-		cout << prefix << getTypeName() << this->m_DELIM << endl;
-		this->id->print(nextPrefix);
-		for(auto it=arguments->begin(); it!=arguments->end(); it++){
-			(*it)->print(nextPrefix);
-		}
-	}
-#endif
 	virtual llvm::Value* codeGen(CodeGenContext&) override ;
 };
 
 class NBinaryOperator : public NExpression {
 public:
 	int op;
-	shared_ptr<NExpression> lhs;
-	shared_ptr<NExpression> rhs;
+	NExpression* lhs = nullptr;
+	NExpression* rhs = nullptr;
 
-    NBinaryOperator(){}
+    NBinaryOperator() : NExpression(NodeKind::BinaryOperator){}
 
-    NBinaryOperator(shared_ptr<NExpression> lhs, int op, shared_ptr<NExpression> rhs)
-            : lhs(lhs), rhs(rhs), op(op) {
+    NBinaryOperator(NExpression* lhs, int op, NExpression* rhs)
+            : NExpression(NodeKind::BinaryOperator), lhs(lhs), rhs(rhs), op(op) {
     }
 
-	std::string getTypeName() const override {
-		return "NBinaryOperator";
+	static bool classof(const Node* node){
+		return node->getKind() == NodeKind::BinaryOperator;
 	}
-#ifdef PRINT_AND_JOSONGEN
-    Json::Value jsonGen() const override {
-        Json::Value root;
-        root["name"] = getTypeName() + this->m_DELIM + std::to_string(op);
-
-        root["children"].append(lhs->jsonGen());
-        root["children"].append(rhs->jsonGen());
-
-        return root;
-    }
-
-	void print(std::string prefix) const override{
-		std::string nextPrefix = prefix+this->m_PREFIX;
-		std::cout << prefix << getTypeName() << this->m_DELIM << op << std::endl;
-
-		lhs->print(nextPrefix);
-		rhs->print(nextPrefix);
-	}
-#endif
 
 	virtual llvm::Value* codeGen(CodeGenContext&) override ;
 };
 
 class NAssignment : public NExpression {
 public:
-	shared_ptr<NIdentifier> lhs;
-	shared_ptr<NExpression> rhs;
+	NIdentifier* lhs = nullptr;
+	NExpression* rhs = nullptr;
 
-    NAssignment(){}
+    NAssignment() : NExpression(NodeKind::Assignment){}
 
-	NAssignment(shared_ptr<NIdentifier> lhs, shared_ptr<NExpression> rhs)
-		: lhs(lhs), rhs(rhs) {
+	NAssignment(NIdentifier* lhs, NExpression* rhs)
+		: NExpression(NodeKind::Assignment), lhs(lhs), rhs(rhs) {
 	}
 
-	std::string getTypeName() const override {
-		return "NAssignment";
-	}
-#ifdef PRINT_AND_JOSONGEN
-	void print(std::string prefix) const override{
-		std::string nextPrefix = prefix+this->m_PREFIX;
-		std::cout << prefix << getTypeName() << this->m_DELIM << std::endl;
-		lhs->print(nextPrefix);
-		rhs->print(nextPrefix);
+	static bool classof(const Node* node){
+		return node->getKind() == NodeKind::Assignment;
 	}
 
-    Json::Value jsonGen() const override {
-        Json::Value root;
-        root["name"] = getTypeName();
-        root["children"].append(lhs->jsonGen());
-        root["children"].append(rhs->jsonGen());
-        return root;
-    }
-#endif
-
 	virtual llvm::Value* codeGen(CodeGenContext&) override ;
 };
 
 class NBlock : public NExpression {
 public:
-	shared_ptr<StatementList> statements = make_shared<StatementList>();
+	StatementList statements;
 
-    NBlock(){
-        ++blockCount;
+    NBlock() : NExpression(NodeKind::Block){
     }
 
-	std::string getTypeName() const override {
-		return "NBlock";
-	}
-#ifdef PRINT_AND_JOSONGEN
-	void print(std::string prefix) const override{
-		std::string nextPrefix = prefix+this->m_PREFIX;
-		std::cout << prefix << getTypeName() << this->m_DELIM << std::endl;
-		for(auto it=statements->begin(); it!=statements->end(); it++){
-			(*it)->print(nextPrefix);
-		}
+	static bool classof(const Node* node){
+		return node->getKind() == NodeKind::Block;
 	}
 
-    Json::Value jsonGen() const override {
-        Json::Value root;
-        root["name"] = getTypeName();
-        for(auto it=statements->begin(); it!=statements->end(); it++){
-            root["children"].append((*it)->jsonGen());
-        }
-        return root;
-    }
-#endif
-
 	virtual llvm::Value* codeGen(CodeGenContext&) override ;
 };
 
 class NExpressionStatement : public NStatement {
 public:
-	shared_ptr<NExpression> expression;
+	NExpression* expression = nullptr;
 
-    NExpressionStatement(){}
+    NExpressionStatement() : NStatement(NodeKind::ExpressionStatement){}
 
-	NExpressionStatement(shared_ptr<NExpression> expression)
-		: expression(expression) {
+	NExpressionStatement(NExpression* expression)
+		: NStatement(NodeKind::ExpressionStatement), expression(expression) {
 	}
 
-	std::string getTypeName() const override {
-		return "NExpressionStatement";
+	static bool classof(const Node* node){
+		return node->getKind() == NodeKind::ExpressionStatement;
 	}
-#ifdef PRINT_AND_JOSONGEN
-	void print(std::string prefix) const override{
-		std::string nextPrefix = prefix+this->m_PREFIX;
-		std::cout << prefix << getTypeName() << this->m_DELIM << std::endl;
-		expression->print(nextPrefix);
-	}
-
-    Json::Value jsonGen() const override {
-        Json::Value root;
-        root["name"] = getTypeName();
-        root["children"].append(expression->jsonGen());
-        return root;
-    }
-#endif
 
 	virtual llvm::Value* codeGen(CodeGenContext&) override ;
 };
 
 class NVariableDeclaration : public NStatement {
 public:
-	const shared_ptr<NIdentifier> type;
-	shared_ptr<NIdentifier> id;
-	shared_ptr<NExpression> assignmentExpr = nullptr;
-    int32_t index;
+	NIdentifier* type = nullptr;
+	NIdentifier* id = nullptr;
+	NExpression* assignmentExpr = nullptr;
 
-    NVariableDeclaration(){}
+    NVariableDeclaration() : NStatement(NodeKind::VariableDeclaration){}
 
-	NVariableDeclaration(const shared_ptr<NIdentifier> type, shared_ptr<NIdentifier> id, shared_ptr<NExpression> assignmentExpr = nullptr)
-		: type(type), id(id), assignmentExpr(assignmentExpr) {
+	NVariableDeclaration(NIdentifier* type, NIdentifier* id, NExpression* assignmentExpr = nullptr)
+		: NStatement(NodeKind::VariableDeclaration), type(type), id(id), assignmentExpr(assignmentExpr) {
             //commit this line to get the clean output
             //std::cout << "isArray = " << type->isArray << std::endl;
             assert(type->isType);
-            assert(!type->isArray || (type->isArray && type->arraySize != nullptr));
+            assert(!type->isArray || !type->arraySize.empty());
 	}
 
-	std::string getTypeName() const override {
-		return "NVariableDeclaration";
+	static bool classof(const Node* node){
+		return node->getKind() == NodeKind::VariableDeclaration;
 	}
-#ifdef PRINT_AND_JOSONGEN
-	void print(std::string prefix) const override{
-		std::string nextPrefix = prefix+this->m_PREFIX;
-		std::cout << prefix << getTypeName() << this->m_DELIM << std::endl;
-		type->print(nextPrefix);
-		id->print(nextPrefix);
-        if( assignmentExpr != nullptr ){
-            assignmentExpr->print(nextPrefix);
-        }
-	}
-
-    Json::Value jsonGen() const override {
-        Json::Value root;
-        root["name"] = getTypeName();
-        root["children"].append(type->jsonGen());
-        root["children"].append(id->jsonGen());
-        if( assignmentExpr != nullptr ){
-            root["children"].append(assignmentExpr->jsonGen());
-        }
-        return root;
-    }
-#endif
 	virtual llvm::Value* codeGen(CodeGenContext&) override ;
 };
 
 class NFunctionDeclaration : public NStatement {
 public:
-	shared_ptr<NIdentifier> type;
-    shared_ptr<NIdentifier> id;
-	shared_ptr<VariableList> arguments = make_shared<VariableList>();
-	shared_ptr<NBlock> block;
+	NIdentifier* type = nullptr;
+    NIdentifier* id = nullptr;
+	VariableList arguments;
+	NBlock* block = nullptr;
     bool isExternal = false;
+    //extern int printf(string format, ...) takes more arguments after its own
+    bool isVariadic = false;
 
-    NFunctionDeclaration(){}
+    NFunctionDeclaration() : NStatement(NodeKind::FunctionDeclaration){}
 
-	NFunctionDeclaration(shared_ptr<NIdentifier> type, shared_ptr<NIdentifier> id, shared_ptr<VariableList> arguments, shared_ptr<NBlock> block, bool isExt = false)
-		: type(type), id(id), arguments(arguments), block(block), isExternal(isExt) {
+	NFunctionDeclaration(NIdentifier* type, NIdentifier* id, const VariableList& arguments, NBlock* block, bool isExt = false, bool isVariadic = false)
+		: NStatement(NodeKind::FunctionDeclaration), type(type), id(id), arguments(arguments), block(block), isExternal(isExt), isVariadic(isVariadic) {
         assert(type->isType);
 	}
 
-	std::string getTypeName() const override {
-		return "NFunctionDeclaration";
+	static bool classof(const Node* node){
+		return node->getKind() == NodeKind::FunctionDeclaration;
 	}
-#ifdef PRINT_AND_JOSONGEN
-	void print(std::string prefix) const override{
-		std::string nextPrefix = prefix+this->m_PREFIX;
-		std::cout << prefix << getTypeName() << this->m_DELIM << std::endl;
-
-		type->print(nextPrefix);
-		id->print(nextPrefix);
-
-		for(auto it=arguments->begin(); it!=arguments->end(); it++){
-			(*it)->print(nextPrefix);
-		}
-
-        assert(isExternal || block != nullptr);
-        if( block )
-		    block->print(nextPrefix);
-	}
-
-    Json::Value jsonGen() const override {
-        Json::Value root;
-        root["name"] = getTypeName();
-        root["children"].append(type->jsonGen());
-        root["children"].append(id->jsonGen());
-
-        for(auto it=arguments->begin(); it!=arguments->end(); it++){
-            root["children"].append((*it)->jsonGen());
-        }
-
-        assert(isExternal || block != nullptr);
-        if( block ){
-            root["children"].append(block->jsonGen());
-        }
-
-        return root;
-    }
-#endif
 
 	virtual llvm::Value* codeGen(CodeGenContext&) override ;
 };
 
 class NStructDeclaration: public NStatement{
 public:
-    std::shared_ptr<NIdentifier> name;
-    std::shared_ptr<VariableList> members = std::make_shared<VariableList>();
-
-    NStructDeclaration(){}
+    NIdentifier* name = nullptr;
+    VariableList members;
 
-    NStructDeclaration(shared_ptr<NIdentifier>  id, shared_ptr<VariableList> arguments)
-            : name(id), members(arguments){
+    NStructDeclaration() : NStatement(NodeKind::StructDeclaration){}
 
-    }
+    NStructDeclaration(NIdentifier* id, const VariableList& arguments)
+            : NStatement(NodeKind::StructDeclaration), name(id), members(arguments){
 
-    std::string getTypeName() const override {
-        return "NStructDeclaration";
-    }
-#ifdef PRINT_AND_JOSONGEN
-    void print(std::string prefix) const override {
-        std::string nextPrefix = prefix+this->m_PREFIX;
-        std::cout << prefix << getTypeName() << this->m_DELIM << this->name->name << std::endl;
-
-        for(auto it=members->begin(); it!=members->end(); it++){
-            (*it)->print(nextPrefix);
-        }
     }
 
-
-    Json::Value jsonGen() const override {
-        Json::Value root;
-        root["name"] = getTypeName() + this->m_DELIM + this->name->name;
-
-        for(auto it=members->begin(); it!=members->end(); it++){
-            root["children"].append((*it)->jsonGen());
-        }
-
-        return root;
+    static bool classof(const Node* node){
+        return node->getKind() == NodeKind::StructDeclaration;
     }
-#endif
 
     virtual llvm::Value* codeGen(CodeGenContext& context) override ;
 };
 
 class NReturnStatement: public NStatement{
 public:
-    shared_ptr<NExpression> expression;
+    NExpression* expression = nullptr;
 
-    NReturnStatement(){}
+    NReturnStatement() : NStatement(NodeKind::ReturnStatement){}
 
-    NReturnStatement(shared_ptr<NExpression>  expression)
-            : expression(expression) {
+    NReturnStatement(NExpression* expression)
+            : NStatement(NodeKind::ReturnStatement), expression(expression) {
 
     }
 
-    std::string getTypeName() const override {
-        return "NReturnStatement";
-    }
-#ifdef PRINT_AND_JOSONGEN
-    Json::Value jsonGen() const override {
-        Json::Value root;
-        root["name"] = getTypeName();
-        root["children"].append(expression->jsonGen());
-        return root;
+    static bool classof(const Node* node){
+        return node->getKind() == NodeKind::ReturnStatement;
     }
-
-    void print(std::string prefix) const override {
-        std::string nextPrefix = prefix + this->m_PREFIX;
-        std::cout << prefix << getTypeName() << this->m_DELIM << std::endl;
-
-        expression->print(nextPrefix);
-    }
-#endif
     virtual llvm::Value* codeGen(CodeGenContext& context) override ;
 
 };
@@ -568,47 +307,21 @@ public:
 class NIfStatement: public NStatement{
 public:
 
-    shared_ptr<NExpression>  condition;
-    shared_ptr<NBlock> trueBlock;          // must not null
-    shared_ptr<NBlock> falseBlock;         // could null
-
-
-    NIfStatement(){}
+    NExpression* condition = nullptr;
+    NBlock* trueBlock = nullptr;          // must not null
+    NBlock* falseBlock = nullptr;         // could null
 
-    NIfStatement(shared_ptr<NExpression>  cond, shared_ptr<NBlock> blk, shared_ptr<NBlock> blk2 = nullptr)
-            : condition(cond), trueBlock(blk), falseBlock(blk2){
 
-    }
-
-    std::string getTypeName() const override {
-        return "NIfStatement";
-    }
-#ifdef PRINT_AND_JOSONGEN
-    void print(std::string prefix) const override{
-        std::string nextPrefix = prefix + this->m_PREFIX;
-        cout << prefix << getTypeName() << this->m_DELIM << endl;
-
-        condition->print(nextPrefix);
-
-        trueBlock->print(nextPrefix);
+    NIfStatement() : NStatement(NodeKind::IfStatement){}
 
-        if( falseBlock ){
-            falseBlock->print(nextPrefix);
-        }
+    NIfStatement(NExpression* cond, NBlock* blk, NBlock* blk2 = nullptr)
+            : NStatement(NodeKind::IfStatement), condition(cond), trueBlock(blk), falseBlock(blk2){
 
     }
 
-    Json::Value jsonGen() const override {
-        Json::Value root;
-        root["name"] = getTypeName();
-        root["children"].append(condition->jsonGen());
-        root["children"].append(trueBlock->jsonGen());
-        if( falseBlock ){
-            root["children"].append(falseBlock->jsonGen());
-        }
-        return root;
+    static bool classof(const Node* node){
+        return node->getKind() == NodeKind::IfStatement;
     }
-#endif
 
     llvm::Value *codeGen(CodeGenContext&) override ;
 
@@ -617,179 +330,86 @@ public:
 
 class NForStatement: public NStatement{
 public:
-    shared_ptr<NExpression> initial, condition, increment;
-    shared_ptr<NBlock>  block;
+    NExpression* initial = nullptr;
+    NExpression* condition = nullptr;
+    NExpression* increment = nullptr;
+    NBlock* block = nullptr;
+    //the @hints written in front of the loop
+    LoopHints hints;
 
-    NForStatement(){}
+    NForStatement() : NStatement(NodeKind::ForStatement){}
 
-    NForStatement(shared_ptr<NBlock> b, shared_ptr<NExpression> init = nullptr, shared_ptr<NExpression> cond = nullptr, shared_ptr<NExpression> incre = nullptr)
-            : block(b), initial(init), condition(cond), increment(incre){
-        if( condition == nullptr ){
-            condition = make_shared<NInteger>(1);
-        }
+    NForStatement(NBlock* b, NExpression* init = nullptr, NExpression* cond = nullptr, NExpression* incre = nullptr)
+            : NStatement(NodeKind::ForStatement), block(b), initial(init), condition(cond), increment(incre){
+        //both for and while always give a condition
+        assert(condition != nullptr);
     }
 
-    std::string getTypeName() const override{
-        return "NForStatement";
+    static bool classof(const Node* node){
+        return node->getKind() == NodeKind::ForStatement;
     }
-#ifdef PRINT_AND_JOSONGEN
-    void print(std::string prefix) const override{
-
-        std::string nextPrefix = prefix + this->m_PREFIX;
-        std::cout << prefix << getTypeName() << this->m_DELIM << std::endl;
-
-        if( initial )
-            initial->print(nextPrefix);
-        if( condition )
-            condition->print(nextPrefix);
-        if( increment )
-            increment->print(nextPrefix);
-
-        block->print(nextPrefix);
-    }
-
-
-    Json::Value jsonGen() const override {
-        Json::Value root;
-        root["name"] = getTypeName();
-
-        if( initial )
-            root["children"].append(initial->jsonGen());
-        if( condition )
-            root["children"].append(condition->jsonGen());
-        if( increment )
-            root["children"].append(increment->jsonGen());
-
-        return root;
-    }
-#endif
     llvm::Value *codeGen(CodeGenContext&) override ;
 
 };
 
 class NStructMember: public NExpression{
 public:
-	shared_ptr<NIdentifier> id;
-	shared_ptr<NIdentifier> member;
+	NIdentifier* id = nullptr;
+	NIdentifier* member = nullptr;
 
-    NStructMember(){}
+    NStructMember() : NExpression(NodeKind::StructMember){}
     
-    NStructMember(shared_ptr<NIdentifier> structName, shared_ptr<NIdentifier>member)
-            : id(structName),member(member) {
+    NStructMember(NIdentifier* structName, NIdentifier* member)
+            : NExpression(NodeKind::StructMember), id(structName),member(member) {
     }
 
-    std::string getTypeName() const override{
-        return "NStructMember";
+    static bool classof(const Node* node){
+        return node->getKind() == NodeKind::StructMember;
     }
-#ifdef PRINT_AND_JOSONGEN
-    void print(std::string prefix) const override{
-
-        std::string nextPrefix = prefix + this->m_PREFIX;
-        cout << prefix << getTypeName() << this->m_DELIM << endl;
-
-        id->print(nextPrefix);
-        member->print(nextPrefix);
-    }
-
-
-    Json::Value jsonGen() const override {
-        Json::Value root;
-        root["name"] = getTypeName();
-
-        root["children"].append(id->jsonGen());
-        root["children"].append(member->jsonGen());
-
-        return root;
-    }
-#endif
     llvm::Value *codeGen(CodeGenContext&) override ;
 
 };
 
 class NArrayIndex: public NExpression{
 public:
-    std::shared_ptr<NIdentifier>  arrayName;
-    std::shared_ptr<ExpressionList> expressions = std::make_shared<ExpressionList>();
-    int32_t aSize;
+    NIdentifier* arrayName = nullptr;
+    ExpressionList expressions;
 
-    NArrayIndex(){}
+    NArrayIndex() : NExpression(NodeKind::ArrayIndex){}
 
-    NArrayIndex(shared_ptr<NIdentifier>  name, shared_ptr<NExpression>  exp)
-            : arrayName(name){
-        expressions->push_back(exp);
+    NArrayIndex(ASTArena& arena, NIdentifier* name, NExpression* exp)
+            : NExpression(NodeKind::ArrayIndex), arrayName(name){
+        expressions.push_back(arena, exp);
     }
 
 
-    NArrayIndex(shared_ptr<NIdentifier>  name, shared_ptr<ExpressionList> list)
-            : arrayName(name), expressions(list){
+    NArrayIndex(NIdentifier* name, const ExpressionList& list)
+            : NExpression(NodeKind::ArrayIndex), arrayName(name), expressions(list){
     }
 
-    std::string getTypeName() const override{
-        return "NArrayIndex";
-    }
-#ifdef PRINT_AND_JOSONGEN
-    void print(std::string prefix) const override{
-        std::string nextPrefix = prefix + this->m_PREFIX;
-        cout << prefix << getTypeName() << this->m_DELIM << endl;
-
-        arrayName->print(nextPrefix);
-        for(auto it=expressions->begin(); it!=expressions->end(); it++){
-            (*it)->print(nextPrefix);
-        }
+    static bool classof(const Node* node){
+        return node->getKind() == NodeKind::ArrayIndex;
     }
 
-    Json::Value jsonGen() const override {
-        Json::Value root;
-        root["name"] = getTypeName();
-
-        root["children"].append(arrayName->jsonGen());
-        for(auto it=expressions->begin(); it!=expressions->end(); it++){
-            root["children"].append((*it)->jsonGen());
-        }
-        return root;
-    }
-#endif
-
     llvm::Value *codeGen(CodeGenContext&) override ;
 
 };
 
 class NArrayAssignment: public NExpression{
 public:
-    std::shared_ptr<NArrayIndex> arrayIndex;
-    std::shared_ptr<NExpression>  expression;
+    NArrayIndex* arrayIndex = nullptr;
+    NExpression* expression = nullptr;
 
-    NArrayAssignment(){}
+    NArrayAssignment() : NExpression(NodeKind::ArrayAssignment){}
 
-    NArrayAssignment(shared_ptr<NArrayIndex> index, shared_ptr<NExpression>  exp)
-            : arrayIndex(index), expression(exp){
+    NArrayAssignment(NArrayIndex* index, NExpression* exp)
+            : NExpression(NodeKind::ArrayAssignment), arrayIndex(index), expression(exp){
 
     }
 
-    std::string getTypeName() const override{
-        return "NArrayAssignment";
+    static bool classof(const Node* node){
+        return node->getKind() == NodeKind::ArrayAssignment;
     }
-#ifdef PRINT_AND_JOSONGEN
-    void print(std::string prefix) const override{
-
-        std::string nextPrefix = prefix + this->m_PREFIX;
-        std::cout << prefix << getTypeName() << this->m_DELIM << std::endl;
-
-        arrayIndex->print(nextPrefix);
-        expression->print(nextPrefix);
-    }
-
-
-    Json::Value jsonGen() const override {
-        Json::Value root;
-        root["name"] = getTypeName();
-
-        root["children"].append(arrayIndex->jsonGen());
-        root["children"].append(expression->jsonGen());
-
-        return root;
-    }
-#endif
 
     llvm::Value *codeGen(CodeGenContext&) override ;
 
@@ -798,43 +418,19 @@ public:
 class NArrayInitialization: public NStatement{
 public:
 
-    NArrayInitialization(){}
-
-    std::shared_ptr<NVariableDeclaration> declaration;
-    std::shared_ptr<ExpressionList> expressionList = std::make_shared<ExpressionList>();
-
-    NArrayInitialization(shared_ptr<NVariableDeclaration> dec, shared_ptr<ExpressionList> list)
-            : declaration(dec), expressionList(list){
-
-    }
+    NArrayInitialization() : NStatement(NodeKind::ArrayInitialization){}
 
-    std::string getTypeName() const override{
-        return "NArrayInitialization";
-    }
-#ifdef PRINT_AND_JOSONGEN
-    void print(std::string prefix) const override{
+    NVariableDeclaration* declaration = nullptr;
+    ExpressionList expressionList;
 
-        std::string nextPrefix = prefix + this->m_PREFIX;
-        std::cout << prefix << getTypeName() << this->m_DELIM << std::endl;
+    NArrayInitialization(NVariableDeclaration* dec, const ExpressionList& list)
+            : NStatement(NodeKind::ArrayInitialization), declaration(dec), expressionList(list){
 
-        declaration->print(nextPrefix);
-        for(auto it=expressionList->begin(); it!=expressionList->end(); it++){
-            (*it)->print(nextPrefix);
-        }
     }
 
-
-    Json::Value jsonGen() const override {
-        Json::Value root;
-        root["name"] = getTypeName();
-
-        root["children"].append(declaration->jsonGen());
-        for(auto it=expressionList->begin(); it!=expressionList->end(); it++)
-            root["children"].append((*it)->jsonGen());
-
-        return root;
+    static bool classof(const Node* node){
+        return node->getKind() == NodeKind::ArrayInitialization;
     }
-#endif
 
     llvm::Value *codeGen(CodeGenContext &context) override ;
 
@@ -842,67 +438,38 @@ public:
 
 class NStructAssignment: public NExpression{
 public:
-    std::shared_ptr<NStructMember> structMember;
-    std::shared_ptr<NExpression>  expression;
+    NStructMember* structMember = nullptr;
+    NExpression* expression = nullptr;
 
-    NStructAssignment(){}
+    NStructAssignment() : NExpression(NodeKind::StructAssignment){}
 
-    NStructAssignment(shared_ptr<NStructMember> member, shared_ptr<NExpression>  exp)
-            : structMember(member), expression(exp){
+    NStructAssignment(NStructMember* member, NExpression* exp)
+            : NExpression(NodeKind::StructAssignment), structMember(member), expression(exp){
 
     }
 
-    std::string getTypeName() const override{
-        return "NStructAssignment";
+    static bool classof(const Node* node){
+        return node->getKind() == NodeKind::StructAssignment;
     }
-#ifdef PRINT_AND_JOSONGEN
-    void print(std::string prefix) const override{
-
-        std::string nextPrefix = prefix + this->m_PREFIX;
-        std::cout << prefix << getTypeName() << this->m_DELIM << std::endl;
-
-        structMember->print(nextPrefix);
-        expression->print(nextPrefix);
-    }
-
-
-    Json::Value jsonGen() const override {
-        Json::Value root;
-        root["name"] = getTypeName();
-
-        root["children"].append(structMember->jsonGen());
-        root["children"].append(expression->jsonGen());
-
-        return root;
-    }
-#endif
     llvm::Value *codeGen(CodeGenContext&) override;
 
 };
 
 class NLiteral: public NExpression{
 public:
-    std::string value;
+    //the text between the quotes, escapes are kept as written;
+    //it points into the source buffer, which outlives the AST
+    llvm::StringRef value;
 
-    NLiteral(){}
+    NLiteral() : NExpression(NodeKind::Literal){}
 
-    NLiteral(const std::string &str) {
-        value = str.substr(1, str.length()-2);
+    NLiteral(llvm::StringRef value)
+            : NExpression(NodeKind::Literal), value(value) {
     }
 
-    std::string getTypeName() const override{
-        return "NLiteral";
-    }
-#ifdef PRINT_AND_JOSONGEN
-    void print(std::string prefix) const override{
-        std::cout << prefix << getTypeName() << this->m_DELIM << value << std::endl;
+    static bool classof(const Node* node){
+        return node->getKind() == NodeKind::Literal;
     }
-    Json::Value jsonGen() const override {
-        Json::Value root;
-        root["name"] = getTypeName() + this->m_DELIM + value;
-        return root;
-    }
-#endif
 
     llvm::Value *codeGen(CodeGenContext&) override;
 
@@ -0,0 +1,27 @@
+#include "ASTPass.h"
+#include "ConstantFold.h"
+#include "Profile.h"
+
+bool ASTPassManager::run(ASTArena& tree){
+    bool changed = false;
+    for(auto& pass: passes){
+        PhaseTimer timer(pass->name());
+        changed |= pass->run(tree);
+    }
+    return changed;
+}
+
+void buildASTPipeline(ASTPassManager& manager, const CompilerOptions& options){
+    //at every level: -O0 runs no LLVM pass, the constants folded and the
+    //branches pruned here are all it gets, and codegen has less to emit
+    if( !options.astPasses )
+        return;
+    manager.add(createConstantFoldPass());
+}
+
+void runASTPasses(ASTArena& tree, const CompilerOptions& options){
+    ASTPassManager manager;
+    buildASTPipeline(manager, options);
+    if( !manager.empty() )
+        manager.run(tree);
+}
@@ -0,0 +1,49 @@
+#ifndef ASTPASS_H
+#define ASTPASS_H
+
+#include <memory>
+#include <vector>
+
+#include "ASTNodes.h"
+#include "Options.h"
+
+//A transformation or analysis of a whole tree, run between parsing and
+//generateCode. Write one with ASTVisitor/ASTRewriter (ASTVisitor.h); new
+//nodes go into the arena of the tree, which is freed with it.
+class ASTPass{
+public:
+    virtual ~ASTPass(){}
+
+    //A string literal, also the phase name in -ftime-report and -ftime-trace
+    virtual const char* name() const = 0;
+
+    //Returns whether the tree changed
+    virtual bool run(ASTArena& tree) = 0;
+};
+
+//Runs its passes in the order they were added, each under its own PhaseTimer
+class ASTPassManager{
+private:
+    std::vector<std::unique_ptr<ASTPass>> passes;
+
+public:
+    //Takes ownership of pass
+    void add(ASTPass* pass){
+        passes.emplace_back(pass);
+    }
+
+    bool empty() const{
+        return passes.empty();
+    }
+
+    //Returns whether any pass changed the tree
+    bool run(ASTArena& tree);
+};
+
+//The passes for the options (-fno-ast-passes), in order
+void buildASTPipeline(ASTPassManager& manager, const CompilerOptions& options);
+
+//Build the pipeline and run it on tree, for the front ends of main, Driver and Server
+void runASTPasses(ASTArena& tree, const CompilerOptions& options);
+
+#endif //ASTPASS_H
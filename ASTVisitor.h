@@ -0,0 +1,319 @@
+#ifndef ASTVISITOR_H
+#define ASTVISITOR_H
+
+#include "ASTNodes.h"
+
+//Hands a single child, when present, or every item of a child list to f
+template<typename F>
+struct ChildCallback{
+    F& f;
+
+    void operator()(Node* child){
+        if( child )
+            f(child);
+    }
+
+    template<typename T>
+    void operator()(const NodeList<T>& list){
+        for(auto child: list)
+            f(child);
+    }
+};
+
+//Call f(Node*) for every child of node that is present, in source order
+template<typename F>
+void forEachChild(const Node* node, F f){
+    ChildCallback<F> child{f};
+    switch( node->getKind() ){
+    case NodeKind::Identifier:
+        child(llvm::cast<NIdentifier>(node)->arraySize);
+        break;
+    case NodeKind::MethodCall:
+        child(llvm::cast<NMethodCall>(node)->id);
+        child(llvm::cast<NMethodCall>(node)->arguments);
+        break;
+    case NodeKind::BinaryOperator:
+        child(llvm::cast<NBinaryOperator>(node)->lhs);
+        child(llvm::cast<NBinaryOperator>(node)->rhs);
+        break;
+    case NodeKind::Assignment:
+        child(llvm::cast<NAssignment>(node)->lhs);
+        child(llvm::cast<NAssignment>(node)->rhs);
+        break;
+    case NodeKind::Block:
+        child(llvm::cast<NBlock>(node)->statements);
+        break;
+    case NodeKind::StructMember:
+        child(llvm::cast<NStructMember>(node)->id);
+        child(llvm::cast<NStructMember>(node)->member);
+        break;
+    case NodeKind::ArrayIndex:
+        child(llvm::cast<NArrayIndex>(node)->arrayName);
+        child(llvm::cast<NArrayIndex>(node)->expressions);
+        break;
+    case NodeKind::ArrayAssignment:
+        child(llvm::cast<NArrayAssignment>(node)->arrayIndex);
+        child(llvm::cast<NArrayAssignment>(node)->expression);
+        break;
+    case NodeKind::StructAssignment:
+        child(llvm::cast<NStructAssignment>(node)->structMember);
+        child(llvm::cast<NStructAssignment>(node)->expression);
+        break;
+    case NodeKind::ExpressionStatement:
+        child(llvm::cast<NExpressionStatement>(node)->expression);
+        break;
+    case NodeKind::VariableDeclaration:
+        child(llvm::cast<NVariableDeclaration>(node)->type);
+        child(llvm::cast<NVariableDeclaration>(node)->id);
+        child(llvm::cast<NVariableDeclaration>(node)->assignmentExpr);
+        break;
+    case NodeKind::FunctionDeclaration:
+        child(llvm::cast<NFunctionDeclaration>(node)->type);
+        child(llvm::cast<NFunctionDeclaration>(node)->id);
+        child(llvm::cast<NFunctionDeclaration>(node)->arguments);
+        child(llvm::cast<NFunctionDeclaration>(node)->block);
+        break;
+    case NodeKind::StructDeclaration:
+        child(llvm::cast<NStructDeclaration>(node)->name);
+        child(llvm::cast<NStructDeclaration>(node)->members);
+        break;
+    case NodeKind::ReturnStatement:
+        child(llvm::cast<NReturnStatement>(node)->expression);
+        break;
+    case NodeKind::IfStatement:
+        child(llvm::cast<NIfStatement>(node)->condition);
+        child(llvm::cast<NIfStatement>(node)->trueBlock);
+        child(llvm::cast<NIfStatement>(node)->falseBlock);
+        break;
+    case NodeKind::ForStatement:
+        child(llvm::cast<NForStatement>(node)->initial);
+        child(llvm::cast<NForStatement>(node)->condition);
+        child(llvm::cast<NForStatement>(node)->increment);
+        child(llvm::cast<NForStatement>(node)->block);
+        break;
+    case NodeKind::ArrayInitialization:
+        child(llvm::cast<NArrayInitialization>(node)->declaration);
+        child(llvm::cast<NArrayInitialization>(node)->expressionList);
+        break;
+    default:
+        break;
+    }
+}
+
+//Dispatch on the kind of a node, in the manner of llvm::InstVisitor: visit(node)
+//calls Derived::visitNInteger(NInteger*) and so on. A class without its own
+//visit method falls back to visitNExpression or visitNStatement, then to
+//visitNode. Nothing is visited recursively, call forEachChild for that.
+template<typename Derived, typename RetTy = void>
+class ASTVisitor{
+private:
+    Derived& derived(){
+        return *static_cast<Derived*>(this);
+    }
+
+public:
+    RetTy visit(Node* node){
+        switch( node->getKind() ){
+        case NodeKind::Double: return derived().visitNDouble(llvm::cast<NDouble>(node));
+        case NodeKind::Integer: return derived().visitNInteger(llvm::cast<NInteger>(node));
+        case NodeKind::Identifier: return derived().visitNIdentifier(llvm::cast<NIdentifier>(node));
+        case NodeKind::MethodCall: return derived().visitNMethodCall(llvm::cast<NMethodCall>(node));
+        case NodeKind::BinaryOperator: return derived().visitNBinaryOperator(llvm::cast<NBinaryOperator>(node));
+        case NodeKind::Assignment: return derived().visitNAssignment(llvm::cast<NAssignment>(node));
+        case NodeKind::Block: return derived().visitNBlock(llvm::cast<NBlock>(node));
+        case NodeKind::StructMember: return derived().visitNStructMember(llvm::cast<NStructMember>(node));
+        case NodeKind::ArrayIndex: return derived().visitNArrayIndex(llvm::cast<NArrayIndex>(node));
+        case NodeKind::ArrayAssignment: return derived().visitNArrayAssignment(llvm::cast<NArrayAssignment>(node));
+        case NodeKind::StructAssignment: return derived().visitNStructAssignment(llvm::cast<NStructAssignment>(node));
+        case NodeKind::Literal: return derived().visitNLiteral(llvm::cast<NLiteral>(node));
+        case NodeKind::ExpressionStatement: return derived().visitNExpressionStatement(llvm::cast<NExpressionStatement>(node));
+        case NodeKind::VariableDeclaration: return derived().visitNVariableDeclaration(llvm::cast<NVariableDeclaration>(node));
+        case NodeKind::FunctionDeclaration: return derived().visitNFunctionDeclaration(llvm::cast<NFunctionDeclaration>(node));
+        case NodeKind::StructDeclaration: return derived().visitNStructDeclaration(llvm::cast<NStructDeclaration>(node));
+        case NodeKind::ReturnStatement: return derived().visitNReturnStatement(llvm::cast<NReturnStatement>(node));
+        case NodeKind::IfStatement: return derived().visitNIfStatement(llvm::cast<NIfStatement>(node));
+        case NodeKind::ForStatement: return derived().visitNForStatement(llvm::cast<NForStatement>(node));
+        case NodeKind::ArrayInitialization: return derived().visitNArrayInitialization(llvm::cast<NArrayInitialization>(node));
+        default: return derived().visitNode(node);
+        }
+    }
+
+    RetTy visitNDouble(NDouble* node){ return derived().visitNExpression(node); }
+    RetTy visitNInteger(NInteger* node){ return derived().visitNExpression(node); }
+    RetTy visitNIdentifier(NIdentifier* node){ return derived().visitNExpression(node); }
+    RetTy visitNMethodCall(NMethodCall* node){ return derived().visitNExpression(node); }
+    RetTy visitNBinaryOperator(NBinaryOperator* node){ return derived().visitNExpression(node); }
+    RetTy visitNAssignment(NAssignment* node){ return derived().visitNExpression(node); }
+    RetTy visitNBlock(NBlock* node){ return derived().visitNExpression(node); }
+    RetTy visitNStructMember(NStructMember* node){ return derived().visitNExpression(node); }
+    RetTy visitNArrayIndex(NArrayIndex* node){ return derived().visitNExpression(node); }
+    RetTy visitNArrayAssignment(NArrayAssignment* node){ return derived().visitNExpression(node); }
+    RetTy visitNStructAssignment(NStructAssignment* node){ return derived().visitNExpression(node); }
+    RetTy visitNLiteral(NLiteral* node){ return derived().visitNExpression(node); }
+
+    RetTy visitNExpressionStatement(NExpressionStatement* node){ return derived().visitNStatement(node); }
+    RetTy visitNVariableDeclaration(NVariableDeclaration* node){ return derived().visitNStatement(node); }
+    RetTy visitNFunctionDeclaration(NFunctionDeclaration* node){ return derived().visitNStatement(node); }
+    RetTy visitNStructDeclaration(NStructDeclaration* node){ return derived().visitNStatement(node); }
+    RetTy visitNReturnStatement(NReturnStatement* node){ return derived().visitNStatement(node); }
+    RetTy visitNIfStatement(NIfStatement* node){ return derived().visitNStatement(node); }
+    RetTy visitNForStatement(NForStatement* node){ return derived().visitNStatement(node); }
+    RetTy visitNArrayInitialization(NArrayInitialization* node){ return derived().visitNStatement(node); }
+
+    RetTy visitNExpression(NExpression* node){ return derived().visitNode(node); }
+    RetTy visitNStatement(NStatement* node){ return derived().visitNode(node); }
+    RetTy visitNode(Node*){ return RetTy(); }
+};
+
+//Bottom up rewriting of a tree in place. Every expression that sits in an
+//expression slot (an operand, an argument, a condition, an initializer, ...)
+//is handed to Derived::rewriteExpression after its own children were rewritten,
+//and the expression returned takes its place. Every statement of a block goes
+//to Derived::rewriteStatement the same way, returning nullptr removes it from
+//the block. Identifiers, declarations and blocks in fixed slots are only
+//descended into. New nodes belong in the arena of the tree; set changed when
+//something was replaced so the pass manager can report it. A Derived that
+//tracks scopes defines its own rewriteChildren(Node*) and calls
+//ASTRewriter::rewriteChildren from it, every descent goes through Derived.
+template<typename Derived>
+class ASTRewriter{
+private:
+    Derived& derived(){
+        return *static_cast<Derived*>(this);
+    }
+
+    void rewriteList(ExpressionList& list){
+        for(size_t i=0; i<list.size(); i++){
+            list.set(i, rewrite(list[i]));
+        }
+    }
+
+    void rewriteList(VariableList& list){
+        for(auto declaration: list){
+            derived().rewriteChildren(declaration);
+        }
+    }
+
+    void rewriteList(StatementList& list){
+        size_t kept = 0;
+        for(size_t i=0; i<list.size(); i++){
+            NStatement* statement = rewrite(list[i]);
+            if( statement != list[i] )
+                changed = true;
+            if( statement )
+                list.set(kept++, statement);
+        }
+        list.truncate(kept);
+    }
+
+    void descend(Node* node){
+        if( node )
+            derived().rewriteChildren(node);
+    }
+
+protected:
+    bool changed = false;
+
+public:
+    NExpression* rewriteExpression(NExpression* expression){
+        return expression;
+    }
+
+    NStatement* rewriteStatement(NStatement* statement){
+        return statement;
+    }
+
+    NExpression* rewrite(NExpression* expression){
+        if( expression == nullptr )
+            return nullptr;
+        derived().rewriteChildren(expression);
+        NExpression* result = derived().rewriteExpression(expression);
+        assert(result && "an expression slot cannot be emptied");
+        if( result != expression )
+            changed = true;
+        return result;
+    }
+
+    NStatement* rewrite(NStatement* statement){
+        derived().rewriteChildren(statement);
+        return derived().rewriteStatement(statement);
+    }
+
+    void rewriteChildren(Node* node){
+        using llvm::cast;
+        switch( node->getKind() ){
+        case NodeKind::Identifier:
+            rewriteList(cast<NIdentifier>(node)->arraySize);
+            break;
+        case NodeKind::MethodCall:
+            rewriteList(cast<NMethodCall>(node)->arguments);
+            break;
+        case NodeKind::BinaryOperator:{
+            auto binary = cast<NBinaryOperator>(node);
+            binary->lhs = rewrite(binary->lhs);
+            binary->rhs = rewrite(binary->rhs);
+            break;
+        }
+        case NodeKind::Assignment:
+            cast<NAssignment>(node)->rhs = rewrite(cast<NAssignment>(node)->rhs);
+            break;
+        case NodeKind::Block:
+            rewriteList(cast<NBlock>(node)->statements);
+            break;
+        case NodeKind::ArrayIndex:
+            rewriteList(cast<NArrayIndex>(node)->expressions);
+            break;
+        case NodeKind::ArrayAssignment:
+            descend(cast<NArrayAssignment>(node)->arrayIndex);
+            cast<NArrayAssignment>(node)->expression = rewrite(cast<NArrayAssignment>(node)->expression);
+            break;
+        case NodeKind::StructAssignment:
+            cast<NStructAssignment>(node)->expression = rewrite(cast<NStructAssignment>(node)->expression);
+            break;
+        case NodeKind::ExpressionStatement:
+            cast<NExpressionStatement>(node)->expression = rewrite(cast<NExpressionStatement>(node)->expression);
+            break;
+        case NodeKind::VariableDeclaration:{
+            auto declaration = cast<NVariableDeclaration>(node);
+            descend(declaration->type);
+            declaration->assignmentExpr = rewrite(declaration->assignmentExpr);
+            break;
+        }
+        case NodeKind::FunctionDeclaration:
+            rewriteList(cast<NFunctionDeclaration>(node)->arguments);
+            descend(cast<NFunctionDeclaration>(node)->block);
+            break;
+        case NodeKind::StructDeclaration:
+            rewriteList(cast<NStructDeclaration>(node)->members);
+            break;
+        case NodeKind::ReturnStatement:
+            cast<NReturnStatement>(node)->expression = rewrite(cast<NReturnStatement>(node)->expression);
+            break;
+        case NodeKind::IfStatement:{
+            auto ifStatement = cast<NIfStatement>(node);
+            ifStatement->condition = rewrite(ifStatement->condition);
+            descend(ifStatement->trueBlock);
+            descend(ifStatement->falseBlock);
+            break;
+        }
+        case NodeKind::ForStatement:{
+            auto forStatement = cast<NForStatement>(node);
+            forStatement->initial = rewrite(forStatement->initial);
+            forStatement->condition = rewrite(forStatement->condition);
+            forStatement->increment = rewrite(forStatement->increment);
+            descend(forStatement->block);
+            break;
+        }
+        case NodeKind::ArrayInitialization:{
+            auto initialization = cast<NArrayInitialization>(node);
+            descend(initialization->declaration);
+            rewriteList(initialization->expressionList);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+};
+
+#endif //ASTVISITOR_H
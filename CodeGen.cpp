@@ -1,17 +1,17 @@
 #include <llvm/IR/Value.h>
-#include <llvm/IR/LegacyPassManager.h>
-#include <llvm/IR/IRPrintingPasses.h>
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/Module.h>
+#include <llvm/IR/Metadata.h>
 #include <limits.h>
 #include <memory.h>
+#include <atomic>
 #include "CodeGen.h"
 #include "ASTNodes.h"
 #include "TypeSystem.h"
+#include "Profile.h"
 //#define DISPLAY_PARSE_PROCESS
-using legacy::PassManager;
 
 #define ISTYPE(value, id) (value->getType()->getTypeID() == id)
 
@@ -32,20 +32,176 @@ static Value* CastToBoolean(CodeGenContext& context, Value* condValue){
     }
 }
 
-static llvm::Value* calcArrayIndex(shared_ptr<NArrayIndex> index, CodeGenContext &context){
-    auto sizeVec = context.getArraySize(index->arrayName->name);
+//The dimensions of an array type, outermost first
+static void getArrayDims(const NIdentifier& type, SmallVectorImpl<uint64_t>& dims){
+    for(auto size: type.arraySize){
+        dims.push_back(cast<NInteger>(size)->value);
+    }
+}
+
+//The C default argument promotions for what a variadic callee gets after its
+//own parameters: a comparison (i1) is zero extended, a narrower integer sign
+//extended to int, a float becomes a double
+static Value* promoteVariadicArgument(CodeGenContext& context, Value* value){
+    Type* type = value->getType();
+    Type* intTy = Type::getInt32Ty(context.llvmContext);
+    if( type->isIntegerTy(1) )
+        return context.builder.CreateZExt(value, intTy);
+    if( type->isIntegerTy() && type->getIntegerBitWidth() < 32 )
+        return context.builder.CreateSExt(value, intTy);
+    if( type->isFloatTy() )
+        return context.builder.CreateFPExt(value, Type::getDoubleTy(context.llvmContext));
+    return value;
+}
+
+//Whether a variable of type becomes an SSA value (SSABuilder) rather than an
+//alloca: the scalars of a function, when -fno-ssa-locals was not given
+static bool isSSALocal(const NIdentifier& type, CodeGenContext& context){
+    return context.ssaLocals && context.currentFunction && !type.isArray && !context.typeSystem.isStruct(type.name);
+}
+
+//Mark the add/sub/mul an index was computed with as nsw, like C where signed
+//overflow is undefined; with it the loop passes can widen the i32 induction
+//variable behind the sext instead of redoing it every iteration. Only the
+//instructions the index alone uses are marked: an SSA local can hand the same
+//mul to later statements, for which ints keep wrapping. So it runs when the
+//function is complete, on the operand of each of indexExtensions
+static void markIndexArithmetic(Value* value){
+    auto binary = dyn_cast<BinaryOperator>(value);
+    if( !binary || !binary->hasOneUse() )
+        return;
+    switch( binary->getOpcode() ){
+        case Instruction::Add:
+        case Instruction::Sub:
+        case Instruction::Mul:
+            binary->setHasNoSignedWrap(true);
+            markIndexArithmetic(binary->getOperand(0));
+            markIndexArithmetic(binary->getOperand(1));
+            break;
+        default:
+            break;
+    }
+}
+
+//The llvm.loop property name, with value unless it is nullptr
+static void addLoopProperty(LLVMContext& llvmContext, SmallVectorImpl<Metadata*>& loopID, const char* name, Metadata* value){
+    SmallVector<Metadata*, 2> property;
+    property.push_back(MDString::get(llvmContext, name));
+    if( value )
+        property.push_back(value);
+    loopID.push_back(MDNode::get(llvmContext, property));
+}
+
+//Put the hints on latch as its llvm.loop metadata. The loop ID is distinct
+//and its first operand is itself, as the loop passes expect. For @independent
+//every memory access from header on, the body of this loop and the loops in
+//it, is marked llvm.mem.parallel_loop_access with the ID, which keeps the ID
+//of an inner loop that was marked before.
+static void attachLoopHints(CodeGenContext& context, const LoopHints& hints, BasicBlock* header, BranchInst* latch){
+    LLVMContext& llvmContext = context.llvmContext;
+    auto count = [&](unsigned value){
+        return ConstantAsMetadata::get(ConstantInt::get(Type::getInt32Ty(llvmContext), value));
+    };
+    auto boolean = [&](bool value){
+        return ConstantAsMetadata::get(ConstantInt::get(Type::getInt1Ty(llvmContext), value));
+    };
+
+    SmallVector<Metadata*, 8> operands;
+    operands.push_back(nullptr);
+    if( hints.flags & LoopHints::Vectorize )
+        addLoopProperty(llvmContext, operands, "llvm.loop.vectorize.enable", boolean(true));
+    if( hints.flags & LoopHints::NoVectorize )
+        addLoopProperty(llvmContext, operands, "llvm.loop.vectorize.enable", boolean(false));
+    if( hints.vectorizeWidth )
+        addLoopProperty(llvmContext, operands, "llvm.loop.vectorize.width", count(hints.vectorizeWidth));
+    if( hints.interleaveCount )
+        addLoopProperty(llvmContext, operands, "llvm.loop.interleave.count", count(hints.interleaveCount));
+    if( hints.unrollCount )
+        addLoopProperty(llvmContext, operands, "llvm.loop.unroll.count", count(hints.unrollCount));
+    else if( hints.flags & LoopHints::Unroll )
+        addLoopProperty(llvmContext, operands, "llvm.loop.unroll.enable", nullptr);
+    if( hints.flags & LoopHints::NoUnroll )
+        addLoopProperty(llvmContext, operands, "llvm.loop.unroll.disable", nullptr);
+
+    MDNode* loopID = MDNode::getDistinct(llvmContext, operands);
+    loopID->replaceOperandWith(0, loopID);
+    latch->setMetadata(LLVMContext::MD_loop, loopID);
+
+    if( !(hints.flags & LoopHints::Independent) )
+        return;
+    Function* function = header->getParent();
+    for(auto block = header->getIterator(); block != function->end(); ++block){
+        for(auto& instruction: *block){
+            if( !instruction.mayReadOrWriteMemory() )
+                continue;
+            MDNode* loops = instruction.getMetadata(LLVMContext::MD_mem_parallel_loop_access);
+            if( loops ){
+                //a single loop ID is its own first operand, otherwise a list of them
+                SmallVector<Metadata*, 4> list;
+                if( loops->getOperand(0).get() == loops ){
+                    list.push_back(loops);
+                }else{
+                    for(auto& loop: loops->operands())
+                        list.push_back(loop);
+                }
+                list.push_back(loopID);
+                loops = MDNode::get(llvmContext, list);
+            }else{
+                loops = loopID;
+            }
+            instruction.setMetadata(LLVMContext::MD_mem_parallel_loop_access, loops);
+        }
+    }
+}
+
+//The address of an element: a single inbounds GEP over the nested array type
+//of a local, or over the row pointer that an array argument holds
+static llvm::Value* arrayElementPointer(NArrayIndex* index, CodeGenContext &context){
+    Symbol name = index->arrayName->name;
+    Value* varPtr = context.getSymbolValue(name);
+    if( !varPtr ){
+        return LogErrorV("Unknown variable name " + name.str().str());
+    }
 #ifdef DISPLAY_PARSE_PROCESS
-    std::cout << "sizeVec:" << sizeVec.size() << ", expressions: " << index->expressions->size() << std::endl;
+    std::cout << "dims:" << context.getArraySize(name).size() << ", expressions: " << index->expressions.size() << std::endl;
 #endif
-    assert(sizeVec.size() > 0 && sizeVec.size() == index->expressions->size());
-    auto expression = *(index->expressions->rbegin());
+    if( context.getArraySize(name).size() != index->expressions.size() ){
+        return LogErrorV("The variable is not array of " + std::to_string(index->expressions.size()) + " dimensions");
+    }
 
-    for(unsigned int i=sizeVec.size()-1; i>=1; i--){
-        auto temp = make_shared<NBinaryOperator>(make_shared<NInteger>(sizeVec[i]), TMUL, index->expressions->at(i-1));
-        expression = make_shared<NBinaryOperator>(temp, TPLUS, expression);
+    Type* indexTy = Type::getInt64Ty(context.llvmContext);
+    SmallVector<Value*, 4> indices;
+    if( context.isFuncArg(name) ){
+        varPtr = context.builder.CreateLoad(varPtr, "actualArrayPtr");
+    }else{
+        indices.push_back(ConstantInt::get(indexTy, 0));
     }
+    for(auto expression: index->expressions){
+        Value* value = expression->codeGen(context);
+        if( !value ){
+            return nullptr;
+        }
+        if( !value->getType()->isIntegerTy() ){
+            return LogErrorV("Array index is not an integer");
+        }
+        Value* extension = context.builder.CreateSExt(value, indexTy, "idxprom");
+        if( auto instruction = dyn_cast<Instruction>(extension) )
+            context.indexExtensions.push_back(instruction);
+        indices.push_back(extension);
+    }
+    return context.builder.CreateInBoundsGEP(varPtr, indices, "elementPtr");
+}
 
-    return expression->codeGen(context);
+AllocaInst* CodeGenContext::createLocal(Type* type, const Twine& name){
+    if( !currentFunction )
+        return builder.CreateAlloca(type, nullptr, name);
+    BasicBlock& entry = currentFunction->getEntryBlock();
+    IRBuilder<> entryBuilder(&entry, lastEntryLocal ? std::next(lastEntryLocal->getIterator()) : entry.begin());
+    lastEntryLocal = entryBuilder.CreateAlloca(type, nullptr, name);
+    //no size: the data layout of the target is only set after codegen
+    builder.CreateLifetimeStart(lastEntryLocal);
+    scopeLocals.push_back(lastEntryLocal);
+    return lastEntryLocal;
 }
 
 void CodeGenContext::generateCode(NBlock& root) {
@@ -60,9 +216,6 @@ void CodeGenContext::generateCode(NBlock& root) {
     popBlock();
 
 
-    PassManager passManager;
-    passManager.add(createPrintModulePass(outs()));
-    passManager.run(*(this->theModule.get()));
     return;
 }
 
@@ -71,17 +224,24 @@ llvm::Value* NAssignment::codeGen(CodeGenContext &context) {
     std::cout << "Generating assignment of " << this->lhs->name << " = " << std::endl;
 #endif
     Value* dst = context.getSymbolValue(this->lhs->name);
-    auto dstType = context.getSymbolType(this->lhs->name);
-    string dstTypeStr = dstType->name;
-    if( !dst ){
+    auto variable = context.getSSAVariable(this->lhs->name);
+    if( !dst && variable < 0 ){
         return LogErrorV("Undeclared variable");
     }
-    Value* exp = exp = this->rhs->codeGen(context);
+    Symbol dstTypeName = context.getSymbolType(this->lhs->name)->name;
+    Value* exp = this->rhs->codeGen(context);
+    if( !exp ){
+        return nullptr;
+    }
 #ifdef DISPLAY_PARSE_PROCESS
-    std::cout << "dst typeid = " << TypeSystem::llvmTypeToStr(context.typeSystem.getVarType(dstTypeStr)) << std::endl;
+    std::cout << "dst typeid = " << TypeSystem::llvmTypeToStr(context.typeSystem.getVarType(dstTypeName)) << std::endl;
     std::cout << "exp typeid = " << TypeSystem::llvmTypeToStr(exp) << std::endl;
 #endif
-    exp = context.typeSystem.cast(exp, context.typeSystem.getVarType(dstTypeStr), context.currentBlock());
+    exp = context.typeSystem.cast(exp, context.typeSystem.getVarType(dstTypeName), context.builder.GetInsertBlock());
+    if( variable >= 0 ){
+        context.ssa.writeVariable(variable, context.builder.GetInsertBlock(), exp);
+        return exp;
+    }
     context.builder.CreateStore(exp, dst);
     return dst;
 }
@@ -155,7 +315,7 @@ llvm::Value* NBlock::codeGen(CodeGenContext &context) {
     std::cout << "Generating block" << std::endl;
 #endif
     Value* last = nullptr;
-    for(auto it=this->statements->begin(); it!=this->statements->end(); it++){
+    for(auto it=this->statements.begin(); it!=this->statements.end(); it++){
         last = (*it)->codeGen(context);
     }
     return last;
@@ -179,19 +339,19 @@ llvm::Value* NIdentifier::codeGen(CodeGenContext &context) {
 #ifdef DISPLAY_PARSE_PROCESS
     std::cout << "Generating identifier " << this->name << std::endl;
 #endif
+    auto variable = context.getSSAVariable(this->name);
+    if( variable >= 0 ){
+        return context.ssa.readVariable(variable, context.builder.GetInsertBlock());
+    }
     Value* value = context.getSymbolValue(this->name);
     if( !value ){
-        return LogErrorV("Unknown variable name " + this->name);
-    }
-    if( value->getType()->isPointerTy() ){
-        auto arrayPtr = context.builder.CreateLoad(value, "arrayPtr");
-        if( arrayPtr->getType()->isArrayTy() ){
-            std::cout << "(Array Type)" << std::endl;
-            std::vector<Value*> indices;
-            indices.push_back(ConstantInt::get(context.typeSystem.intTy, 0, false));
-            auto ptr = context.builder.CreateInBoundsGEP(value, indices, "arrayPtr");
-            return ptr;
-        }
+        return LogErrorV("Unknown variable name " + this->name.str().str());
+    }
+    if( value->getType()->getPointerElementType()->isArrayTy() ){
+        //an array decays to a pointer to its first element
+        Value* zero = ConstantInt::get(Type::getInt64Ty(context.llvmContext), 0);
+        Value* indices[] = {zero, zero};
+        return context.builder.CreateInBoundsGEP(value, indices, "arrayPtr");
     }
     return context.builder.CreateLoad(value, false, "");
 
@@ -202,58 +362,72 @@ llvm::Value* NExpressionStatement::codeGen(CodeGenContext &context) {
 }
 
 llvm::Value* NFunctionDeclaration::codeGen(CodeGenContext &context) {
+    PhaseTimer timer("codegen", this->id->name.str());
 #ifdef DISPLAY_PARSE_PROCESS
     std::cout << "Generating function declaration of " << this->id->name << std::endl;
 #endif
     std::vector<Type*> argTypes;
 
-    for(auto &arg: *this->arguments){
-        if( arg->type->isArray ){
-            argTypes.push_back(PointerType::get(context.typeSystem.getVarType(arg->type->name), 0));
-        } else{
-            argTypes.push_back(TypeOf(*arg->type, context));
-        }
+    //arrays are passed and returned as a pointer to their first element
+    for(auto &arg: this->arguments){
+        argTypes.push_back(TypeOf(*arg->type, context));
     }
-    Type* retType = nullptr;
-    if( this->type->isArray )
-        retType = PointerType::get(context.typeSystem.getVarType(this->type->name), 0);
-    else
-        retType = TypeOf(*this->type, context);
+    Type* retType = TypeOf(*this->type, context);
 
-    FunctionType* functionType = FunctionType::get(retType, argTypes, false);
-    Function* function = Function::Create(functionType, GlobalValue::ExternalLinkage, this->id->name.c_str(), context.theModule.get());
+    //only extern int printf(string format, ...) takes extra arguments; a fixed
+    //extern keeps the type of its definition in another file, so the linked
+    //call of --whole-program is direct and can be inlined
+    FunctionType* functionType = FunctionType::get(retType, argTypes, this->isVariadic);
+    Function* function = Function::Create(functionType, GlobalValue::ExternalLinkage, this->id->name.str(), context.theModule.get());
 
-    if( !this->isExternal ){
+    if( !this->isExternal && !context.declarationOnly.count(this->id->name) ){
         BasicBlock* basicBlock = BasicBlock::Create(context.llvmContext, "entry", function, nullptr);
 
         context.builder.SetInsertPoint(basicBlock);
         context.pushBlock(basicBlock);
+        context.beginFunction(function);
+        context.ssa.sealBlock(basicBlock);
 
         // declare function params
-        auto origin_arg = this->arguments->begin();
+        auto origin_arg = this->arguments.begin();
 
         for(auto &ir_arg_it: function->args()){
-            ir_arg_it.setName((*origin_arg)->id->name);
-            Value* argAlloc;
-            if( (*origin_arg)->type->isArray )
-                argAlloc = context.builder.CreateAlloca(PointerType::get(context.typeSystem.getVarType((*origin_arg)->type->name), 0));
-            else
-                argAlloc = (*origin_arg)->codeGen(context);
-
-            context.builder.CreateStore(&ir_arg_it, argAlloc, false);
-            context.setSymbolValue((*origin_arg)->id->name, argAlloc);
+            ir_arg_it.setName((*origin_arg)->id->name.str());
+            if( isSSALocal(*(*origin_arg)->type, context) ){
+                //the argument is the first definition, no slot needed
+                auto variable = context.ssa.newVariable(ir_arg_it.getType(), (*origin_arg)->id->name.str());
+                context.ssa.writeVariable(variable, basicBlock, &ir_arg_it);
+                context.setSSAVariable((*origin_arg)->id->name, variable);
+            }else{
+                Value* argAlloc;
+                if( (*origin_arg)->type->isArray ){
+                    SmallVector<uint64_t, 4> arraySizes;
+                    getArrayDims(*(*origin_arg)->type, arraySizes);
+                    context.setArraySize((*origin_arg)->id->name, arraySizes);
+                    argAlloc = context.createLocal(TypeOf(*(*origin_arg)->type, context));
+                }else{
+                    argAlloc = (*origin_arg)->codeGen(context);
+                }
+                context.builder.CreateStore(&ir_arg_it, argAlloc, false);
+                context.setSymbolValue((*origin_arg)->id->name, argAlloc);
+            }
             context.setSymbolType((*origin_arg)->id->name, (*origin_arg)->type);
             context.setFuncArg((*origin_arg)->id->name, true);
             origin_arg++;
         }
 
         this->block->codeGen(context);
-        if( context.getCurrentReturnValue() ){
-            context.builder.CreateRet(context.getCurrentReturnValue());
+        Value* returnValue = context.getCurrentReturnValue();
+        context.popBlock();
+        context.endFunction();
+        if( returnValue ){
+            context.builder.CreateRet(returnValue);
+            for(auto extension: context.indexExtensions){
+                markIndexArithmetic(extension->getOperand(0));
+            }
         } else{
             return LogErrorV("Function block return value not founded");
         }
-        context.popBlock();
 
     }
 
@@ -267,10 +441,10 @@ llvm::Value* NStructDeclaration::codeGen(CodeGenContext& context) {
     std::cout << "Generating struct declaration of " << this->name->name << std::endl;
 #endif
     std::vector<Type*> memberTypes;
-    auto structType = StructType::create(context.llvmContext, this->name->name);
+    auto structType = StructType::create(context.llvmContext, this->name->name.str());
     context.typeSystem.addStructType(this->name->name, structType);
 
-    for(auto& member: *this->members){
+    for(auto& member: this->members){
         context.typeSystem.addStructMember(this->name->name, member->type->name, member->id->name);
         memberTypes.push_back(TypeOf(*member->type, context));
     }
@@ -284,20 +458,23 @@ llvm::Value* NMethodCall::codeGen(CodeGenContext &context) {
 #ifdef DISPLAY_PARSE_PROCESS
     std::cout << "Generating method call of " << this->id->name << std::endl;
 #endif
-    Function * calleeF = context.theModule->getFunction(this->id->name);
+    Function * calleeF = context.theModule->getFunction(this->id->name.str());
     if( !calleeF ){
-        LogErrorV("Function name not found");
+        return LogErrorV("Function name not found");
     }
-    if( calleeF->arg_size() != this->arguments->size() ){
-        //Here is a bug???
-        LogErrorV("Function arguments size not match, calleeF=" + std::to_string(calleeF->size()) + ", this->arguments=" + std::to_string(this->arguments->size()) );
+    bool countMatches = calleeF->isVarArg() ? this->arguments.size() >= calleeF->arg_size() : this->arguments.size() == calleeF->arg_size();
+    if( !countMatches ){
+        return LogErrorV("Function arguments size not match, calleeF=" + std::to_string(calleeF->arg_size()) + ", this->arguments=" + std::to_string(this->arguments.size()) );
     }
     std::vector<Value*> argsv;
-    for(auto it=this->arguments->begin(); it!=this->arguments->end(); it++){
+    for(auto it=this->arguments.begin(); it!=this->arguments.end(); it++){
         argsv.push_back((*it)->codeGen(context));
         if( !argsv.back() ){        // if any argument codegen fail
             return nullptr;
         }
+        if( argsv.size() > calleeF->arg_size() ){
+            argsv.back() = promoteVariadicArgument(context, argsv.back());
+        }
     }
     return context.builder.CreateCall(calleeF, argsv, "calltmp");
 }
@@ -311,25 +488,23 @@ llvm::Value* NVariableDeclaration::codeGen(CodeGenContext &context) {
 
     Value* inst = nullptr;
 
-    if( this->type->isArray ){
-        uint64_t arraySize = 1;
-        std::vector<uint64_t> arraySizes;
-        for(auto it=this->type->arraySize->begin(); it!=this->type->arraySize->end(); it++){
-            NInteger* integer = dynamic_cast<NInteger*>(it->get());
-            arraySize *= integer->value;
-            arraySizes.push_back(integer->value);
-        }
-
+    if( isSSALocal(*this->type, context) ){
+        auto variable = context.ssa.newVariable(type, this->id->name.str());
+        //undefined until assigned, like a fresh alloca
+        context.ssa.writeVariable(variable, context.builder.GetInsertBlock(), UndefValue::get(type));
+        context.setSSAVariable(this->id->name, variable);
+    }else if( this->type->isArray ){
+        SmallVector<uint64_t, 4> arraySizes;
+        getArrayDims(*this->type, arraySizes);
         context.setArraySize(this->id->name, arraySizes);
-        Value* arraySizeValue = NInteger(arraySize).codeGen(context);
-        auto arrayType = ArrayType::get(context.typeSystem.getVarType(this->type->name), arraySize);
-        inst = context.builder.CreateAlloca(arrayType, arraySizeValue, "arraytmp");
+        inst = context.createLocal(context.typeSystem.getArrayType(*this->type), "arraytmp");
+        context.setSymbolValue(this->id->name, inst);
     }else{
-        inst = context.builder.CreateAlloca(type);
+        inst = context.createLocal(type);
+        context.setSymbolValue(this->id->name, inst);
     }
 
     context.setSymbolType(this->id->name, this->type);
-    context.setSymbolValue(this->id->name, inst);
 
     context.PrintSymTable();
 
@@ -370,6 +545,10 @@ llvm::Value* NIfStatement::codeGen(CodeGenContext &context) {
     } else{
         context.builder.CreateCondBr(condValue, thenBB, mergeBB);
     }
+    //a block is sealed for SSABuilder once every branch to it exists
+    context.ssa.sealBlock(thenBB);
+    if( this->falseBlock )
+        context.ssa.sealBlock(falseBB);
 
     context.builder.SetInsertPoint(thenBB);
 
@@ -398,6 +577,7 @@ llvm::Value* NIfStatement::codeGen(CodeGenContext &context) {
         context.builder.CreateBr(mergeBB);
     }
 
+    context.ssa.sealBlock(mergeBB);
     theFunction->getBasicBlockList().push_back(mergeBB);        
     context.builder.SetInsertPoint(mergeBB);        
 
@@ -440,7 +620,13 @@ llvm::Value* NForStatement::codeGen(CodeGenContext &context) {
     // execute the again or stop
     condValue = this->condition->codeGen(context);
     condValue = CastToBoolean(context, condValue);
-    context.builder.CreateCondBr(condValue, block, after);
+    BranchInst* latch = context.builder.CreateCondBr(condValue, block, after);
+    if( !this->hints.empty() )
+        attachLoopHints(context, this->hints, block, latch);
+
+    // the back edge is there, the phis of the loop get their last operand
+    context.ssa.sealBlock(block);
+    context.ssa.sealBlock(after);
 
     // insert the after block
     theFunction->getBasicBlockList().push_back(after);
@@ -461,7 +647,7 @@ llvm::Value *NStructMember::codeGen(CodeGenContext &context) {
         return LogErrorV("The variable is not struct");
     }
 
-    string structName = structPtr->getType()->getStructName().str();
+    Symbol structName = context.typeSystem.getStructName(cast<StructType>(structPtr->getType()));
     long memberIndex = context.typeSystem.getStructMemberIndex(structName, this->member->name);
 
     std::vector<Value*> indices;
@@ -484,7 +670,7 @@ llvm::Value* NStructAssignment::codeGen(CodeGenContext &context) {
         return LogErrorV("The variable is not struct");
     }
 
-    string structName = structPtr->getType()->getStructName().str();
+    Symbol structName = context.typeSystem.getStructName(cast<StructType>(structPtr->getType()));
     long memberIndex = context.typeSystem.getStructMemberIndex(structName, this->structMember->member->name);
 
     std::vector<Value*> indices;
@@ -502,37 +688,11 @@ llvm::Value *NArrayIndex::codeGen(CodeGenContext &context) {
 #ifdef DISPLAY_PARSE_PROCESS
     std::cout << "Generating array index expression of " << this->arrayName->name << std::endl;
 #endif
-    auto varPtr = context.getSymbolValue(this->arrayName->name);
-    auto type = context.getSymbolType(this->arrayName->name);
-    string typeStr = type->name;
-
-    assert(type->isArray);
-
-    auto value = calcArrayIndex(make_shared<NArrayIndex>(*this), context);
-    //The indices is the reference to consecutinve address which is store 
-    //in the otherplace and can live longer than the reference
-    ArrayRef<Value*> indices;
-
-    //if this array is the pointer pass-in by the caller so we use the arg that pass
-    //in as the true reference
-    if(context.isFuncArg(this->arrayName->name) ){
-        std::cout << "isFuncArg" << std::endl;
-        varPtr = context.builder.CreateLoad(varPtr, "actualArrayPtr");
-        //Here is a bug to be free
-        //Aware that
-        //The 6.0 api is not the same with the 4.0 api
-        indices =  value ;//This line may be wrong.
-        //indices = {0,value};
-    }else if( varPtr->getType()->isPointerTy() ){
-        std::cout << this->arrayName->name << "Not isFuncArg" << std::endl;
-        indices = { ConstantInt::get(Type::getInt64Ty(context.llvmContext), 0), value };
-    }else{
-        return LogErrorV("The variable is not array");
+    auto ptr = arrayElementPointer(this, context);
+    if( !ptr ){
+        return nullptr;
     }
-    auto ptr = context.builder.CreateInBoundsGEP(varPtr, indices, "elementPtr");
-
     return context.builder.CreateAlignedLoad(ptr, 4);
-    
 }
 
 
@@ -540,21 +700,10 @@ llvm::Value *NArrayAssignment::codeGen(CodeGenContext &context) {
 #ifdef DISPLAY_PARSE_PROCESS
     std::cout << "Generating array index assignment of " << this->arrayIndex->arrayName->name << std::endl;
 #endif
-    auto varPtr = context.getSymbolValue(this->arrayIndex->arrayName->name);
-
-    if( varPtr == nullptr ){
-        return LogErrorV("Unknown variable name");
-    }
-    
-    auto arrayPtr = context.builder.CreateLoad(varPtr, "arrayPtr");
-
-    if( !arrayPtr->getType()->isArrayTy() && !arrayPtr->getType()->isPointerTy() ){
-        return LogErrorV("The variable is not array");
+    auto ptr = arrayElementPointer(this->arrayIndex, context);
+    if( !ptr ){
+        return nullptr;
     }
-    auto index = calcArrayIndex(arrayIndex, context);
-    ArrayRef<Value*> gep2_array{ ConstantInt::get(Type::getInt64Ty(context.llvmContext), 0), index };
-    auto ptr = context.builder.CreateInBoundsGEP(varPtr, gep2_array, "elementPtr");
-
     return context.builder.CreateAlignedStore(this->expression->codeGen(context), ptr, 4);
 }
 
@@ -563,26 +712,26 @@ llvm::Value *NArrayInitialization::codeGen(CodeGenContext &context) {
     std::cout << "Generating array initialization of " << this->declaration->id->name << std::endl;
 #endif
     auto arrayPtr = this->declaration->codeGen(context);
-    auto sizeVec = context.getArraySize(this->declaration->id->name);
-    assert(sizeVec.size() == 1);
-
-    for(int index=0; index < this->expressionList->size(); index++){
-        shared_ptr<NInteger> indexValue = make_shared<NInteger>(index);
+    if( context.getArraySize(this->declaration->id->name).size() != 1 ){
+        return LogErrorV("Only an array of one dimension takes an initializer list");
+    }
 
-        shared_ptr<NArrayIndex> arrayIndex = make_shared<NArrayIndex>(this->declaration->id, indexValue);
-        NArrayAssignment assignment(arrayIndex, this->expressionList->at(index));
-        assignment.codeGen(context);
+    Type* indexTy = Type::getInt64Ty(context.llvmContext);
+    for(size_t index=0; index < this->expressionList.size(); index++){
+        Value* indices[] = { ConstantInt::get(indexTy, 0), ConstantInt::get(indexTy, index) };
+        auto ptr = context.builder.CreateInBoundsGEP(arrayPtr, indices, "elementPtr");
+        context.builder.CreateAlignedStore(this->expressionList[index]->codeGen(context), ptr, 4);
     }
     return nullptr;
 }
 
 llvm::Value *NLiteral::codeGen(CodeGenContext &context) {
-    return context.builder.CreateGlobalString(this->value, "string");
+    return context.builder.CreateGlobalString(this->value.str(), "string");
 }
 
 
 std::unique_ptr<NExpression> LogError(const char *str) {
-    static int64_t errorCount=0;
+    static std::atomic<int64_t> errorCount(0);
     ++errorCount;
     //fprintf(stderr,"LogError%lld: %s\n",errorCount,str);
     return nullptr;
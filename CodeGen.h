@@ -7,138 +7,184 @@
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/Module.h>
-#include <json/json.h>
 
+#include <algorithm>
 #include <stack>
 #include <vector>
 #include <memory>
 #include <string>
 #include <map>
+#include <set>
 #include <unordered_map>
+#include <unordered_set>
 #include "ASTNodes.h"
 #include "grammar.hpp"
+#include "ScopedSymbolTable.h"
+#include "SSABuilder.h"
 #include "TypeSystem.h"
 
 using namespace llvm;
 using std::unique_ptr;
 using std::string;
 
-using SymTable = std::map<std::string, Value*>;
+//Keyed by interned names, a lookup hashes and compares pointers only
+using SymTable = std::unordered_map<Symbol, Value*>;
 
+//A scope of codegen: a function body, a branch of an if or a loop body
 class CodeGenBlock{
 public:
     BasicBlock * block;
     Value * returnValue;
-    std::map<std::string, Value*> locals;
-    std::map<std::string, shared_ptr<NIdentifier>> types;     
-    std::map<std::string, bool> isFuncArg;
-    std::map<std::string, std::vector<uint64_t>> arraySizes;
+    //the size of scopeLocals when the scope was entered
+    size_t localsStart;
 };
 
 class CodeGenContext{
 private:
-    std::vector<CodeGenBlock*> theBlockStack;
+    std::vector<CodeGenBlock> theBlockStack;
+    ScopedSymbolTable symbols;
+    //the stack slots of the open scopes of the current function, in
+    //declaration order; popBlock ends the lifetime of those of its scope
+    std::vector<AllocaInst*> scopeLocals;
+    //the last slot put in the entry block, the next one goes after it
+    AllocaInst* lastEntryLocal = nullptr;
 public:
     LLVMContext llvmContext;
     IRBuilder<> builder;
     unique_ptr<Module> theModule;
     SymTable globalVars;
     TypeSystem typeSystem;
+    //Storage made during code generation (array dimensions), freed with the context
+    ASTArena scratch;
+    //Functions emitted as declarations only, their bodies come from the function cache
+    std::unordered_set<Symbol> declarationOnly;
+    //Scalar locals and arguments become SSA values instead of allocas
+    //(-fno-ssa-locals turns it off)
+    bool ssaLocals = true;
+    SSABuilder ssa;
+    //The function whose body is being generated, nullptr at the top level
+    Function* currentFunction = nullptr;
+    //The sext of every array index of the current function; the arithmetic
+    //behind them is marked nsw once the body is done and its uses are known
+    std::vector<Instruction*> indexExtensions;
+
+    //Start and finish the body of function
+    void beginFunction(Function* function){
+        currentFunction = function;
+        lastEntryLocal = nullptr;
+        indexExtensions.clear();
+    }
+
+    void endFunction(){
+        currentFunction = nullptr;
+        lastEntryLocal = nullptr;
+        ssa.clear();
+    }
+
+    //The stack slot of a local. In a function it goes to the entry block, so
+    //a declaration in a loop body takes one slot rather than one per
+    //iteration, and its lifetime starts here and ends with its scope, so stack
+    //coloring can give scopes that never overlap the same frame space.
+    AllocaInst* createLocal(Type* type, const Twine& name = "");
 
     CodeGenContext(): builder(llvmContext), typeSystem(llvmContext){
         theModule = unique_ptr<Module>(new Module("main", this->llvmContext));
     }
 
-    Value* getSymbolValue(std::string name) const{
-        for(auto it=theBlockStack.rbegin(); it!=theBlockStack.rend(); it++){
-            if( (*it)->locals.find(name) != (*it)->locals.end() ){
-                return (*it)->locals[name];
-            }
-        }
-        return nullptr;
+    Value* getSymbolValue(Symbol name) const{
+        const SymbolInfo* info = symbols.lookup(name);
+        return info ? info->value : nullptr;
     }
 
-    shared_ptr<NIdentifier> getSymbolType(std::string name) const{
-        for(auto it=theBlockStack.rbegin(); it!=theBlockStack.rend(); it++){
-            if( (*it)->types.find(name) != (*it)->types.end() ){
-                return (*it)->types[name];
-            }
-        }
-        return nullptr;
+    NIdentifier* getSymbolType(Symbol name) const{
+        const SymbolInfo* info = symbols.lookup(name);
+        return info ? info->type : nullptr;
     }
 
-    bool isFuncArg(std::string name) const{
+    bool isFuncArg(Symbol name) const{
+        const SymbolInfo* info = symbols.lookup(name);
+        return info && info->isFuncArg;
+    }
 
-        for(auto it=theBlockStack.rbegin(); it!=theBlockStack.rend(); it++){
-            if( (*it)->isFuncArg.find(name) != (*it)->isFuncArg.end() ){
-                return (*it)->isFuncArg[name];
-            }
-        }
-        return false;
+    //The memory a variable lives in
+    void setSymbolValue(Symbol name, Value* value){
+        SymbolInfo& info = symbols.declare(name);
+        info.value = value;
+        info.ssaVariable = -1;
+    }
+
+    void setSSAVariable(Symbol name, SSABuilder::Variable variable){
+        SymbolInfo& info = symbols.declare(name);
+        info.value = nullptr;
+        info.ssaVariable = variable;
     }
 
-    void setSymbolValue(std::string name, Value* value){
-        theBlockStack.back()->locals[name] = value;
+    //-1 for a name that is not an SSA variable
+    SSABuilder::Variable getSSAVariable(Symbol name) const{
+        const SymbolInfo* info = symbols.lookup(name);
+        return info ? info->ssaVariable : -1;
     }
 
-    void setSymbolType(std::string name, shared_ptr<NIdentifier> value){
-        theBlockStack.back()->types[name] = value;
+    void setSymbolType(Symbol name, NIdentifier* value){
+        symbols.declare(name).type = value;
     }
 
-    void setFuncArg(std::string name, bool value){
+    void setFuncArg(Symbol name, bool value){
         //std::cout << "Set " << name << " as func arg" << std::endl;
-        theBlockStack.back()->isFuncArg[name] = value;
+        symbols.declare(name).isFuncArg = value;
     }
 
     BasicBlock* currentBlock() const{
-        return theBlockStack.back()->block;
+        return theBlockStack.back().block;
     }
 
     void pushBlock(BasicBlock * block){
-        CodeGenBlock * codeGenBlock = new CodeGenBlock();
-        codeGenBlock->block = block;
-        codeGenBlock->returnValue = nullptr;
+        CodeGenBlock codeGenBlock;
+        codeGenBlock.block = block;
+        codeGenBlock.returnValue = nullptr;
+        codeGenBlock.localsStart = scopeLocals.size();
         theBlockStack.push_back(codeGenBlock);
+        symbols.enterScope();
     }
 
+    //The builder has to be at the end of the scope, its locals end there
     void popBlock(){
-        CodeGenBlock * codeGenBlock = theBlockStack.back();
+        size_t start = theBlockStack.back().localsStart;
+        while( scopeLocals.size() > start ){
+            builder.CreateLifetimeEnd(scopeLocals.back());
+            scopeLocals.pop_back();
+        }
+        symbols.leaveScope();
         theBlockStack.pop_back();
-        delete codeGenBlock;
     }
 
     void setCurrentReturnValue(Value* value){
-        theBlockStack.back()->returnValue = value;
+        theBlockStack.back().returnValue = value;
     }
 
     Value* getCurrentReturnValue(){
-        return theBlockStack.back()->returnValue;
+        return theBlockStack.back().returnValue;
     }
 
-    void setArraySize(std::string name, std::vector<uint64_t> value){
+    //The dimensions are copied to the scratch arena, so the ArrayRef that
+    //getArraySize returns stays good as long as the context
+    void setArraySize(Symbol name, ArrayRef<uint64_t> value){
         //std::cout << "setArraySize: " << name << ": " << value.size() << std::endl;
-        theBlockStack.back()->arraySizes[name] = value;
+        uint64_t* copy = scratch.allocateArray<uint64_t>(value.size());
+        std::copy(value.begin(), value.end(), copy);
+        symbols.declare(name).arraySize = ArrayRef<uint64_t>(copy, value.size());
     }
 
-    std::vector<uint64_t> getArraySize(std::string name){
-        for(auto it=theBlockStack.rbegin(); it!=theBlockStack.rend(); it++){
-            if( (*it)->arraySizes.find(name) != (*it)->arraySizes.end() ){
-                return (*it)->arraySizes[name];
-            }
-        }
-        return theBlockStack.back()->arraySizes[name];
+    //Empty for a name that is not an array
+    ArrayRef<uint64_t> getArraySize(Symbol name) const{
+        const SymbolInfo* info = symbols.lookup(name);
+        return info ? info->arraySize : ArrayRef<uint64_t>();
     }
 
     void PrintSymTable() const{
     #ifdef PRINT_SYMBOL_TABLE
         std::cout << "======= Print Symbol Table ==================" << std::endl;
-        std::string prefix = "";
-        for(auto it=theBlockStack.begin(); it!=theBlockStack.end(); it++){
-            for(auto it2=(*it)->locals.begin(); it2!=(*it)->locals.end(); it2++){
-                std::cout << prefix << it2->first << " = " << it2->second << ": " << this->getSymbolType(it2->first) << std::endl;
-            }
-            prefix += "\t";
-        }
+        symbols.print(std::cout);
         std::cout << "=============================================" << std::endl;
     #endif
     }
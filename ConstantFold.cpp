@@ -0,0 +1,310 @@
+#include <llvm/ADT/SmallVector.h>
+
+#include <stdint.h>
+#include <unordered_set>
+#include <utility>
+
+#include "ConstantFold.h"
+#include "ASTVisitor.h"
+#include "grammar.hpp"
+
+using namespace llvm;
+
+namespace {
+
+bool isConstant(const NExpression* expression){
+    return expression && (isa<NInteger>(expression) || isa<NDouble>(expression));
+}
+
+//NInteger::codeGen truncates to i32, NBinaryOperator converts with UIToFP
+double toDouble(const NExpression* constant){
+    if( auto integer = dyn_cast<NInteger>(constant) )
+        return (double)(uint32_t)integer->value;
+    return cast<NDouble>(constant)->value;
+}
+
+//lhs op rhs on i32, false when codegen would not give a constant: division
+//by zero, INT_MIN / -1, shifts by 32 or more
+bool foldInteger(int op, uint32_t lhs, uint32_t rhs, uint32_t& result){
+    int32_t signedLhs = (int32_t)lhs;
+    int32_t signedRhs = (int32_t)rhs;
+    switch( op ){
+    case TPLUS: result = lhs + rhs; return true;
+    case TMINUS: result = lhs - rhs; return true;
+    case TMUL: result = lhs * rhs; return true;
+    case TDIV:
+        if( rhs == 0 || (signedLhs == INT32_MIN && signedRhs == -1) )
+            return false;
+        result = (uint32_t)(signedLhs / signedRhs);
+        return true;
+    case TAND: result = lhs & rhs; return true;
+    case TOR: result = lhs | rhs; return true;
+    case TXOR: result = lhs ^ rhs; return true;
+    case TSHIFTL:
+        if( rhs >= 32 )
+            return false;
+        result = lhs << rhs;
+        return true;
+    case TSHIFTR:
+        if( rhs >= 32 )
+            return false;
+        result = signedLhs < 0 ? ~(~lhs >> rhs) : lhs >> rhs;
+        return true;
+    default:
+        return false;
+    }
+}
+
+//Bit operations on doubles are codegen errors and stay for it to report
+bool foldDouble(int op, double lhs, double rhs, double& result){
+    switch( op ){
+    case TPLUS: result = lhs + rhs; return true;
+    case TMINUS: result = lhs - rhs; return true;
+    case TMUL: result = lhs * rhs; return true;
+    case TDIV: result = lhs / rhs; return true;
+    default: return false;
+    }
+}
+
+//The comparisons give an i1, only a condition can take their value as is.
+//Like codegen TCLT is unsigned on ints and unordered on doubles.
+bool foldComparison(int op, const NExpression* lhs, const NExpression* rhs, bool& result){
+    if( isa<NInteger>(lhs) && isa<NInteger>(rhs) ){
+        uint32_t left = (uint32_t)cast<NInteger>(lhs)->value;
+        uint32_t right = (uint32_t)cast<NInteger>(rhs)->value;
+        switch( op ){
+        case TCLT: result = left < right; return true;
+        case TCLE: result = (int32_t)left <= (int32_t)right; return true;
+        case TCGE: result = (int32_t)left >= (int32_t)right; return true;
+        case TCGT: result = (int32_t)left > (int32_t)right; return true;
+        case TCEQ: result = left == right; return true;
+        case TCNE: result = left != right; return true;
+        default: return false;
+        }
+    }
+    double left = toDouble(lhs);
+    double right = toDouble(rhs);
+    switch( op ){
+    case TCLT: result = !(left >= right); return true;
+    case TCLE: result = left <= right; return true;
+    case TCGE: result = left >= right; return true;
+    case TCGT: result = left > right; return true;
+    case TCEQ: result = left == right; return true;
+    case TCNE: result = left < right || left > right; return true;
+    default: return false;
+    }
+}
+
+//Whether condition is known to hold, as CastToBoolean would decide it: an
+//int is truncated to i1 so only its low bit counts, a double is ONE 0.0
+bool decideCondition(const NExpression* condition, bool& taken){
+    if( auto integer = dyn_cast_or_null<NInteger>(condition) ){
+        taken = integer->value & 1;
+        return true;
+    }
+    if( auto number = dyn_cast_or_null<NDouble>(condition) ){
+        taken = number->value < 0 || number->value > 0;
+        return true;
+    }
+    auto binary = dyn_cast_or_null<NBinaryOperator>(condition);
+    if( binary && isConstant(binary->lhs) && isConstant(binary->rhs) )
+        return foldComparison(binary->op, binary->lhs, binary->rhs, taken);
+    return false;
+}
+
+//What the names of a function refer to, innermost last. Codegen resolves a
+//name when it reaches it, so the bindings follow the walk: a declaration
+//shadows from its own statement on, to the end of its block.
+class Scopes{
+private:
+    //the constant a local stands for, nullptr for arguments and other locals
+    SmallVector<std::pair<Symbol, NExpression*>, 32> bindings;
+    SmallVector<size_t, 8> starts;
+
+public:
+    void enter(){
+        starts.push_back(bindings.size());
+    }
+
+    void leave(){
+        bindings.resize(starts.pop_back_val());
+    }
+
+    void bind(Symbol name){
+        bindings.push_back(std::make_pair(name, (NExpression*)nullptr));
+    }
+
+    void setLastConstant(NExpression* constant){
+        bindings.back().second = constant;
+    }
+
+    //nullptr for names bound to something else and for globals
+    NExpression* lookup(Symbol name) const{
+        for(size_t i=bindings.size(); i>0; i--){
+            if( bindings[i-1].first == name )
+                return bindings[i-1].second;
+        }
+        return nullptr;
+    }
+};
+
+//The names assigned anywhere under node. A local is only propagated when its
+//name is never assigned in the function, whichever declaration is meant.
+void collectAssigned(const Node* node, std::unordered_set<Symbol>& names){
+    if( auto assignment = dyn_cast<NAssignment>(node) )
+        names.insert(assignment->lhs->name);
+    forEachChild(node, [&names](Node* child){
+        collectAssigned(child, names);
+    });
+}
+
+class ConstantFolder: public ASTRewriter<ConstantFolder>{
+private:
+    ASTArena& tree;
+    Scopes scopes;
+    //the function being rewritten, nothing is propagated outside of one
+    NFunctionDeclaration* function = nullptr;
+    std::unordered_set<Symbol> assigned;
+
+    NExpression* makeConstant(const NExpression* constant){
+        if( auto integer = dyn_cast<NInteger>(constant) )
+            return tree.make<NInteger>(integer->value);
+        return tree.make<NDouble>(cast<NDouble>(constant)->value);
+    }
+
+    NExpression* foldBinary(NBinaryOperator* binary){
+        if( !isConstant(binary->lhs) || !isConstant(binary->rhs) )
+            return binary;
+        if( isa<NInteger>(binary->lhs) && isa<NInteger>(binary->rhs) ){
+            uint32_t result;
+            if( foldInteger(binary->op, (uint32_t)cast<NInteger>(binary->lhs)->value, (uint32_t)cast<NInteger>(binary->rhs)->value, result) )
+                return tree.make<NInteger>(result);
+            return binary;
+        }
+        double result;
+        if( foldDouble(binary->op, toDouble(binary->lhs), toDouble(binary->rhs), result) )
+            return tree.make<NDouble>(result);
+        return binary;
+    }
+
+    //A local that keeps the value of its initializer, of its own type so
+    //no cast is lost
+    bool isPropagated(const NVariableDeclaration* declaration) const{
+        const NExpression* initial = declaration->assignmentExpr;
+        if( !function || !initial || declaration->type->isArray || assigned.count(declaration->id->name) )
+            return false;
+        uint32_t type = declaration->type->name.id();
+        return (type == IntSymbol && isa<NInteger>(initial)) || (type == DoubleSymbol && isa<NDouble>(initial));
+    }
+
+    static bool declaresLocals(const NBlock* block){
+        for(auto statement: block->statements){
+            if( isa<NVariableDeclaration>(statement) || isa<NArrayInitialization>(statement) )
+                return true;
+        }
+        return false;
+    }
+
+    //The statement to run in place of the if, block being the taken branch
+    NStatement* takeBranch(NIfStatement* ifStatement, NBlock* block){
+        if( block == nullptr || block->statements.empty() )
+            return nullptr;
+        //the branch is a scope of its own, its locals must not leak out
+        if( declaresLocals(block) ){
+            ifStatement->condition = tree.make<NInteger>(1);
+            ifStatement->trueBlock = block;
+            ifStatement->falseBlock = nullptr;
+            changed = true;
+            return ifStatement;
+        }
+        return tree.make<NExpressionStatement>(block);
+    }
+
+public:
+    ConstantFolder(ASTArena& tree) : tree(tree){}
+
+    bool run(){
+        rewriteChildren(tree.root);
+        return changed;
+    }
+
+    void rewriteChildren(Node* node){
+        switch( node->getKind() ){
+        case NodeKind::FunctionDeclaration:
+            function = cast<NFunctionDeclaration>(node);
+            assigned.clear();
+            if( function->block )
+                collectAssigned(function->block, assigned);
+            scopes.enter();
+            ASTRewriter::rewriteChildren(node);
+            scopes.leave();
+            function = nullptr;
+            break;
+        case NodeKind::Block:
+            scopes.enter();
+            ASTRewriter::rewriteChildren(node);
+            scopes.leave();
+            break;
+        case NodeKind::VariableDeclaration:
+            //codegen binds the name before it evaluates the initializer
+            if( function )
+                scopes.bind(cast<NVariableDeclaration>(node)->id->name);
+            ASTRewriter::rewriteChildren(node);
+            break;
+        default:
+            ASTRewriter::rewriteChildren(node);
+            break;
+        }
+    }
+
+    NExpression* rewriteExpression(NExpression* expression){
+        if( auto identifier = dyn_cast<NIdentifier>(expression) ){
+            NExpression* constant = function ? scopes.lookup(identifier->name) : nullptr;
+            return constant ? makeConstant(constant) : expression;
+        }
+        if( auto binary = dyn_cast<NBinaryOperator>(expression) )
+            return foldBinary(binary);
+        return expression;
+    }
+
+    NStatement* rewriteStatement(NStatement* statement){
+        if( auto declaration = dyn_cast<NVariableDeclaration>(statement) ){
+            //every read is replaced, so the declaration has nothing left to do
+            if( isPropagated(declaration) ){
+                scopes.setLastConstant(declaration->assignmentExpr);
+                return nullptr;
+            }
+            return statement;
+        }
+        bool taken;
+        if( auto ifStatement = dyn_cast<NIfStatement>(statement) ){
+            if( decideCondition(ifStatement->condition, taken) )
+                return takeBranch(ifStatement, taken ? ifStatement->trueBlock : ifStatement->falseBlock);
+            return statement;
+        }
+        if( auto forStatement = dyn_cast<NForStatement>(statement) ){
+            //a loop that never runs leaves its initial expression
+            if( decideCondition(forStatement->condition, taken) && !taken )
+                return forStatement->initial ? tree.make<NExpressionStatement>(forStatement->initial) : nullptr;
+            return statement;
+        }
+        return statement;
+    }
+};
+
+class ConstantFoldPass: public ASTPass{
+public:
+    const char* name() const override{
+        return "constant folding";
+    }
+
+    bool run(ASTArena& tree) override{
+        return ConstantFolder(tree).run();
+    }
+};
+
+}
+
+ASTPass* createConstantFoldPass(){
+    return new ConstantFoldPass();
+}
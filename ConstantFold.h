@@ -0,0 +1,13 @@
+#ifndef CONSTANTFOLD_H
+#define CONSTANTFOLD_H
+
+#include "ASTPass.h"
+
+//Evaluates NBinaryOperator trees whose leaves are NInteger/NDouble the way
+//codegen would (i32 wrapping, unsigned int to double), replaces the reads of
+//int and double locals that are initialized with a constant and never
+//assigned by that constant, and drops the branches of if and for statements
+//whose condition is constant.
+ASTPass* createConstantFoldPass();
+
+#endif //CONSTANTFOLD_H
@@ -0,0 +1,243 @@
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#include "ASTFile.h"
+#include "ASTPass.h"
+#include "CodeGen.h"
+#include "Driver.h"
+#include "FunctionCache.h"
+#include "ObjGen.h"
+#include "Optimizer.h"
+#include "Profile.h"
+
+using namespace llvm;
+
+static std::mutex diagnosticsMutex;
+
+static void reportError(const string& input, const string& message){
+    std::lock_guard<std::mutex> lock(diagnosticsMutex);
+    errs() << input << ": " << message << "\n";
+}
+
+//Read, parse and generate one input, then verify and run the -O pipeline on it
+static bool generateModule(const string& input, CodeGenContext& context, TargetMachine* targetMachine, FunctionCache* cache, const CompilerOptions& options){
+    //the literals of the AST point into source, it lives until the module is generated
+    string readError;
+    std::unique_ptr<SourceBuffer> source = SourceBuffer::fromFile(input, readError);
+    if( !source ){
+        reportError(input, "cannot read file: " + readError);
+        return false;
+    }
+
+    //the whole tree is freed at once when it goes out of scope after codegen
+    string error;
+    std::unique_ptr<ASTArena> tree = loadProgram(*source, options.lexer, error);
+    if( !tree ){
+        reportError(input, error);
+        return false;
+    }
+    runASTPasses(*tree, options);
+
+    context.llvmContext.setDiscardValueNames(options.discardValueNames);
+    context.ssaLocals = options.ssaLocals;
+
+    if( cache ){
+        if( !cache->generateCode(*tree->root, context, targetMachine, options) ){
+            reportError(input, "code generation failed");
+            return false;
+        }
+        return true;
+    }
+
+    {
+        PhaseTimer timer("codegen");
+        context.generateCode(*tree->root);
+    }
+
+    string verifierMessage;
+    raw_string_ostream verifierStream(verifierMessage);
+    if( !prepareModule(*context.theModule, targetMachine, options, verifierStream) ){
+        reportError(input, verifierStream.str());
+        return false;
+    }
+    return true;
+}
+
+//-emit-ast, only parse the input and write its tree next to it
+static bool writeAST(const string& input, const CompilerOptions& options){
+    string output = outputFileFor(input, options);
+    if( output == input ){
+        reportError(input, "is already an AST file");
+        return false;
+    }
+    string error;
+    std::unique_ptr<SourceBuffer> source = SourceBuffer::fromFile(input, error);
+    if( !source ){
+        reportError(input, "cannot read file: " + error);
+        return false;
+    }
+    std::unique_ptr<ASTArena> tree = loadProgram(*source, options.lexer, error);
+    if( !tree ){
+        reportError(input, error);
+        return false;
+    }
+    std::error_code errorCode;
+    raw_fd_ostream dest(output, errorCode, sys::fs::F_None);
+    if( errorCode ){
+        reportError(output, errorCode.message());
+        return false;
+    }
+    writeASTFile(*tree->root, dest);
+    return true;
+}
+
+static bool compileFile(const string& input, TargetMachine* targetMachine, FunctionCache* cache, const CompilerOptions& options){
+    if( options.emit == OutputKind::AST )
+        return writeAST(input, options);
+
+    CodeGenContext context;
+    if( !generateModule(input, context, targetMachine, cache, options) )
+        return false;
+
+    string output = outputFileFor(input, options);
+    std::error_code errorCode;
+    raw_fd_ostream dest(output, errorCode, sys::fs::F_None);
+    if( errorCode ){
+        reportError(output, errorCode.message());
+        return false;
+    }
+    return emitOutput(*context.theModule, targetMachine, options.emit, dest);
+}
+
+//Run task(index, targetMachine) for every input index on up to options.jobs threads.
+//Returns false when any task failed.
+template<typename Task>
+static bool runOnWorkers(size_t count, const CompilerOptions& options, Task task){
+    unsigned jobs = options.jobs ? options.jobs : std::thread::hardware_concurrency();
+    jobs = std::max(1u, std::min<unsigned>(jobs, count));
+
+    std::atomic<size_t> next(0);
+    std::atomic<bool> failed(false);
+
+    auto worker = [&](){
+        //a TargetMachine is not safe to share between threads, every worker keeps its own
+        std::unique_ptr<TargetMachine> targetMachine(createTargetMachine(options));
+        if( !targetMachine ){
+            failed = true;
+            return;
+        }
+        for(size_t index = next++; index < count; index = next++){
+            if( !task(index, targetMachine.get()) )
+                failed = true;
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for(unsigned i=1; i<jobs; i++){
+        workers.emplace_back(worker);
+    }
+    worker();
+    for(auto& thread: workers){
+        thread.join();
+    }
+    return !failed;
+}
+
+int compileFiles(const std::vector<string>& inputs, const CompilerOptions& options){
+    //target registration is process wide, do it once before any worker starts
+    doInit();
+
+    std::unique_ptr<FunctionCache> cache;
+    if( !options.cacheDir.empty() )
+        cache.reset(new FunctionCache(options.cacheDir));
+
+    bool succeeded = runOnWorkers(inputs.size(), options, [&](size_t index, TargetMachine* targetMachine){
+        return compileFile(inputs[index], targetMachine, cache.get(), options);
+    });
+
+    if( cache )
+        cache->printStats();
+    return succeeded ? 0 : 1;
+}
+
+int compileWholeProgram(const std::vector<string>& inputs, const CompilerOptions& options, const string& output){
+    doInit();
+
+    //Every input becomes a bitcode module, written next to it (foo.input -> foo.bc)
+    std::vector<string> bitcodes(inputs.size());
+    bool succeeded = runOnWorkers(inputs.size(), options, [&](size_t index, TargetMachine* targetMachine){
+        CodeGenContext context;
+        if( !generateModule(inputs[index], context, targetMachine, nullptr, options) )
+            return false;
+
+        raw_string_ostream bitcodeStream(bitcodes[index]);
+        WriteBitcodeToFile(context.theModule.get(), bitcodeStream);
+        bitcodeStream.flush();
+
+        SmallString<128> bitcodeFile(inputs[index]);
+        sys::path::replace_extension(bitcodeFile, "bc");
+        std::error_code errorCode;
+        raw_fd_ostream bitcodeOut(bitcodeFile, errorCode, sys::fs::F_None);
+        if( errorCode ){
+            reportError(bitcodeFile.str().str(), errorCode.message());
+            return false;
+        }
+        bitcodeOut << bitcodes[index];
+        bitcodeOut.close();
+        if( bitcodeOut.has_error() ){
+            reportError(bitcodeFile.str().str(), bitcodeOut.error().message());
+            bitcodeOut.clear_error();
+            return false;
+        }
+        return true;
+    });
+    if( !succeeded )
+        return 1;
+
+    //Link them all into one module of one context
+    LLVMContext llvmContext;
+    llvmContext.setDiscardValueNames(options.discardValueNames);
+    auto program = std::unique_ptr<Module>(new Module("program", llvmContext));
+    Linker linker(*program);
+    {
+        PhaseTimer timer("link");
+        for(size_t index=0; index<inputs.size(); index++){
+            auto module = parseBitcodeFile(MemoryBufferRef(bitcodes[index], inputs[index]), llvmContext);
+            if( !module ){
+                reportError(inputs[index], toString(module.takeError()));
+                return 1;
+            }
+            if( linker.linkInModule(std::move(*module)) ){
+                reportError(inputs[index], "cannot be linked into the program");
+                return 1;
+            }
+        }
+    }
+
+    std::unique_ptr<TargetMachine> targetMachine(createTargetMachine(options));
+    if( !targetMachine )
+        return 1;
+
+    std::set<string> exported(options.exports.begin(), options.exports.end());
+    exported.insert("main");
+    if( !optimizeWholeProgram(*program, targetMachine.get(), options.optLevel, options.sizeLevel, exported, options.loopHintReport) )
+        return 1;
+
+    std::error_code errorCode;
+    raw_fd_ostream dest(output, errorCode, sys::fs::F_None);
+    if( errorCode ){
+        reportError(output, errorCode.message());
+        return 1;
+    }
+    return emitOutput(*program, targetMachine.get(), options.emit, dest) ? 0 : 1;
+}
@@ -0,0 +1,21 @@
+#ifndef DRIVER_H
+#define DRIVER_H
+
+#include <string>
+#include <vector>
+#include "Options.h"
+
+//Compile every input file to an object file next to it (foo.input -> foo.o)
+//on options.jobs worker threads. Each worker owns its CodeGenContext and
+//TargetMachine, and parses with a state of its own.
+//Returns 0 when all inputs compiled, 1 otherwise.
+//With options.cacheDir set, unchanged functions come from the function cache.
+int compileFiles(const std::vector<std::string>& inputs, const CompilerOptions& options);
+
+//Whole-program mode: every input is generated into a bitcode module (written
+//as foo.bc), the modules are linked into one, everything but main and the
+//exported symbols is internalized and the interprocedural pipeline runs over
+//the merged module before a single object file is written to output.
+int compileWholeProgram(const std::vector<std::string>& inputs, const CompilerOptions& options, const std::string& output);
+
+#endif //DRIVER_H
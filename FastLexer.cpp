@@ -0,0 +1,328 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#define LEXER_SIMD
+#endif
+
+#include "FastLexer.h"
+
+using llvm::StringRef;
+
+enum CharClass : uint8_t{
+    Space = 1,          //[ \t\r\n]
+    IdentifierStart = 2, //[a-zA-Z_]
+    IdentifierChar = 4, //[a-zA-Z0-9_]
+    Digit = 8,          //[0-9]
+};
+
+struct CharTable{
+    uint8_t classes[256];
+
+    CharTable(){
+        memset(classes, 0, sizeof(classes));
+        for(const char* c = " \t\r\n"; *c; c++)
+            classes[(uint8_t)*c] = Space;
+        for(int c='a'; c<='z'; c++)
+            classes[c] = classes[c - 'a' + 'A'] = IdentifierStart | IdentifierChar;
+        classes['_'] = IdentifierStart | IdentifierChar;
+        for(int c='0'; c<='9'; c++)
+            classes[c] = IdentifierChar | Digit;
+    }
+
+    bool is(char c, uint8_t charClass) const{
+        return classes[(uint8_t)c] & charClass;
+    }
+};
+
+static const CharTable charTable;
+
+#ifdef LEXER_SIMD
+//A block of bytes and the few compares the scanner needs. The compares are
+//signed, bytes from 0x80 up are below every ASCII range and never match one.
+#ifdef __AVX2__
+typedef __m256i Vector;
+static const size_t vectorWidth = 32;
+static const uint32_t allBytes = 0xFFFFFFFFu;
+
+static inline Vector load(const char* p){ return _mm256_loadu_si256((const __m256i*)p); }
+static inline Vector equal(Vector v, char c){ return _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c)); }
+static inline Vector above(Vector v, char c){ return _mm256_cmpgt_epi8(v, _mm256_set1_epi8(c)); }
+static inline Vector below(Vector v, char c){ return _mm256_cmpgt_epi8(_mm256_set1_epi8(c), v); }
+static inline Vector both(Vector a, Vector b){ return _mm256_and_si256(a, b); }
+static inline Vector either(Vector a, Vector b){ return _mm256_or_si256(a, b); }
+static inline Vector lowerCase(Vector v){ return _mm256_or_si256(v, _mm256_set1_epi8(0x20)); }
+static inline uint32_t bits(Vector v){ return (uint32_t)_mm256_movemask_epi8(v); }
+#else
+typedef __m128i Vector;
+static const size_t vectorWidth = 16;
+static const uint32_t allBytes = 0xFFFFu;
+
+static inline Vector load(const char* p){ return _mm_loadu_si128((const __m128i*)p); }
+static inline Vector equal(Vector v, char c){ return _mm_cmpeq_epi8(v, _mm_set1_epi8(c)); }
+static inline Vector above(Vector v, char c){ return _mm_cmpgt_epi8(v, _mm_set1_epi8(c)); }
+static inline Vector below(Vector v, char c){ return _mm_cmplt_epi8(v, _mm_set1_epi8(c)); }
+static inline Vector both(Vector a, Vector b){ return _mm_and_si128(a, b); }
+static inline Vector either(Vector a, Vector b){ return _mm_or_si128(a, b); }
+static inline Vector lowerCase(Vector v){ return _mm_or_si128(v, _mm_set1_epi8(0x20)); }
+static inline uint32_t bits(Vector v){ return (uint32_t)_mm_movemask_epi8(v); }
+#endif
+
+static inline Vector inRange(Vector v, char low, char high){
+    return both(above(v, low - 1), below(v, high + 1));
+}
+#endif
+
+//Every run class says which bytes continue the run, bytewise and a block at a time
+
+struct SpaceRun{
+    static bool byte(char c){ return charTable.is(c, Space); }
+#ifdef LEXER_SIMD
+    static uint32_t block(Vector v){
+        return bits(either(either(equal(v, ' '), equal(v, '\t')), either(equal(v, '\r'), equal(v, '\n'))));
+    }
+#endif
+};
+
+struct IdentifierRun{
+    static bool byte(char c){ return charTable.is(c, IdentifierChar); }
+#ifdef LEXER_SIMD
+    static uint32_t block(Vector v){
+        //'@' '[' '`' '{' are next to the letters, or-ing in 0x20 moves none of them into a-z
+        Vector letter = inRange(lowerCase(v), 'a', 'z');
+        return bits(either(either(letter, inRange(v, '0', '9')), equal(v, '_')));
+    }
+#endif
+};
+
+struct DigitRun{
+    static bool byte(char c){ return charTable.is(c, Digit); }
+#ifdef LEXER_SIMD
+    static uint32_t block(Vector v){
+        return bits(inRange(v, '0', '9'));
+    }
+#endif
+};
+
+//The rest of a # comment
+struct LineRun{
+    static bool byte(char c){ return c != '\n'; }
+#ifdef LEXER_SIMD
+    static uint32_t block(Vector v){
+        return ~bits(equal(v, '\n'));
+    }
+#endif
+};
+
+//Up to the next quote of a literal
+struct LiteralRun{
+    static bool byte(char c){ return c != '"'; }
+#ifdef LEXER_SIMD
+    static uint32_t block(Vector v){
+        return ~bits(equal(v, '"'));
+    }
+#endif
+};
+
+//Return the first byte from p on that does not continue the run. Blocks are
+//only loaded while they lie within the source, the tail goes bytewise.
+template<typename Run>
+static inline const char* skip(const char* p, const char* end){
+#ifdef LEXER_SIMD
+    while( (size_t)(end - p) >= vectorWidth ){
+        uint32_t stop = ~Run::block(load(p)) & allBytes;
+        if( stop )
+            return p + __builtin_ctz(stop);
+        p += vectorWidth;
+    }
+#endif
+    while( p < end && Run::byte(*p) )
+        p++;
+    return p;
+}
+
+struct Keyword{
+    const char* text;
+    size_t length;
+    int token;
+    //the interned symbol of a type keyword, 0 for the others
+    uint32_t symbol;
+};
+
+//(first + 21 * last + length) mod 32 differs for all keywords, one slot to compare
+static inline unsigned keywordSlot(const char* text, size_t length){
+    return ((uint8_t)text[0] + 21u * (uint8_t)text[length - 1] + (unsigned)length) & 31;
+}
+
+struct KeywordTable{
+    Keyword slots[32];
+
+    KeywordTable(){
+        static const Keyword keywords[] = {
+            {"int", 3, TYINT, IntSymbol},
+            {"double", 6, TYDOUBLE, DoubleSymbol},
+            {"float", 5, TYFLOAT, FloatSymbol},
+            {"char", 4, TYCHAR, CharSymbol},
+            {"bool", 4, TYBOOL, BoolSymbol},
+            {"string", 6, TYSTRING, StringSymbol},
+            {"void", 4, TYVOID, VoidSymbol},
+            {"extern", 6, TEXTERN, 0},
+            {"if", 2, TIF, 0},
+            {"else", 4, TELSE, 0},
+            {"return", 6, TRETURN, 0},
+            {"for", 3, TFOR, 0},
+            {"while", 5, TWHILE, 0},
+            {"struct", 6, TSTRUCT, 0},
+        };
+        memset(slots, 0, sizeof(slots));
+        for(auto& keyword: keywords)
+            slots[keywordSlot(keyword.text, keyword.length)] = keyword;
+    }
+
+    const Keyword* find(const char* text, size_t length) const{
+        const Keyword& keyword = slots[keywordSlot(text, length)];
+        if( keyword.length == length && memcmp(keyword.text, text, length) == 0 )
+            return &keyword;
+        return nullptr;
+    }
+};
+
+static const KeywordTable keywordTable;
+
+int FastLexer::next(YYSTYPE& value){
+    const char* p = cursor;
+    for(;;){
+        p = skip<SpaceRun>(p, end);
+        if( p < end && *p == '#' ){
+            p = skip<LineRun>(p + 1, end);
+            continue;
+        }
+        break;
+    }
+    tokenStart = p;
+    if( p == end ){
+        cursor = p;
+        return 0;
+    }
+
+    char c = *p;
+    if( charTable.is(c, IdentifierStart) ){
+        cursor = skip<IdentifierRun>(p + 1, end);
+        size_t length = cursor - p;
+        if( const Keyword* keyword = keywordTable.find(p, length) ){
+            if( keyword->symbol )
+                value.symbol = keywordSymbol((KeywordSymbol)keyword->symbol);
+            else
+                value.token = keyword->token;
+            return keyword->token;
+        }
+        value.symbol = intern(StringRef(p, length));
+        return TIDENTIFIER;
+    }
+
+    if( charTable.is(c, Digit) ){
+        const char* digits = skip<DigitRun>(p + 1, end);
+        if( digits < end && *digits == '.' ){
+            cursor = skip<DigitRun>(digits + 1, end);
+            //atof on the token alone, like yytext; in place it would read an exponent after it
+            std::string text(p, cursor - p);
+            value.real = atof(text.c_str());
+            return TDOUBLE;
+        }
+        cursor = digits;
+        value.integer = strtoull(p, nullptr, 10);
+        return TINTEGER;
+    }
+
+    if( c == '"' ){
+        //the literal ends at the first quote not preceded by a backslash; without
+        //one, flex's longest match still ends it at the last escaped quote
+        const char* close = nullptr;
+        for(const char* q = skip<LiteralRun>(p + 1, end); q < end; q = skip<LiteralRun>(q + 1, end)){
+            close = q;
+            if( q[-1] != '\\' )
+                break;
+        }
+        if( close ){
+            cursor = close + 1;
+            value.text.data = p + 1;
+            value.text.length = cursor - p - 2;
+            return TLITERAL;
+        }
+    }
+
+    //operators, one or two bytes
+    cursor = p + 1;
+    char following = cursor < end ? *cursor : '\0';
+    int token;
+    switch (c){
+        case '=':
+            token = following == '=' ? TCEQ : TEQUAL;
+            break;
+        case '!':
+            token = following == '=' ? TCNE : 0;
+            break;
+        case '<':
+            token = following == '=' ? TCLE : following == '<' ? TSHIFTL : TCLT;
+            break;
+        case '>':
+            token = following == '=' ? TCGE : following == '>' ? TSHIFTR : TCGT;
+            break;
+        case '(': token = TLPAREN; break;
+        case ')': token = TRPAREN; break;
+        case '{': token = TLBRACE; break;
+        case '}': token = TRBRACE; break;
+        case '[': token = TLBRACKET; break;
+        case ']': token = TRBRACKET; break;
+        case '.':
+            token = following == '.' && cursor + 1 < end && cursor[1] == '.' ? TELLIPSIS : TDOT;
+            break;
+        case ',': token = TCOMMA; break;
+        case '+': token = TPLUS; break;
+        case '-': token = TMINUS; break;
+        case '*': token = TMUL; break;
+        case '/': token = TDIV; break;
+        case '&': token = TAND; break;
+        case '|': token = TOR; break;
+        case '^': token = TXOR; break;
+        case '%': token = TMOD; break;
+        case ';': token = TSEMICOLON; break;
+        case '@': token = TAT; break;
+        default: token = 0; break;
+    }
+    if( token == 0 ){
+        printf("Unknown token:%c\n", c);
+        return 0;
+    }
+    if( token == TCEQ || token == TCNE || token == TCLE || token == TCGE || token == TSHIFTL || token == TSHIFTR )
+        cursor++;
+    else if( token == TELLIPSIS )
+        cursor += 2;
+    value.token = token;
+    return token;
+}
+
+const char* tokenName(int token){
+    switch (token){
+#define TOKEN_NAME(t) case t: return #t;
+        TOKEN_NAME(TIDENTIFIER) TOKEN_NAME(TYINT) TOKEN_NAME(TYDOUBLE) TOKEN_NAME(TYFLOAT)
+        TOKEN_NAME(TYCHAR) TOKEN_NAME(TYBOOL) TOKEN_NAME(TYVOID) TOKEN_NAME(TYSTRING)
+        TOKEN_NAME(TLITERAL) TOKEN_NAME(TINTEGER) TOKEN_NAME(TDOUBLE)
+        TOKEN_NAME(TCEQ) TOKEN_NAME(TCNE) TOKEN_NAME(TCLT) TOKEN_NAME(TCLE) TOKEN_NAME(TCGT)
+        TOKEN_NAME(TCGE) TOKEN_NAME(TEQUAL) TOKEN_NAME(TLPAREN) TOKEN_NAME(TRPAREN)
+        TOKEN_NAME(TLBRACE) TOKEN_NAME(TRBRACE) TOKEN_NAME(TCOMMA) TOKEN_NAME(TDOT)
+        TOKEN_NAME(TSEMICOLON) TOKEN_NAME(TLBRACKET) TOKEN_NAME(TRBRACKET) TOKEN_NAME(TQUOTATION)
+        TOKEN_NAME(TPLUS) TOKEN_NAME(TMINUS) TOKEN_NAME(TMUL) TOKEN_NAME(TDIV) TOKEN_NAME(TAND)
+        TOKEN_NAME(TOR) TOKEN_NAME(TXOR) TOKEN_NAME(TMOD) TOKEN_NAME(TNEG) TOKEN_NAME(TNOT)
+        TOKEN_NAME(TSHIFTL) TOKEN_NAME(TSHIFTR) TOKEN_NAME(TIF) TOKEN_NAME(TELSE) TOKEN_NAME(TFOR)
+        TOKEN_NAME(TWHILE) TOKEN_NAME(TRETURN) TOKEN_NAME(TSTRUCT) TOKEN_NAME(TEXTERN)
+        TOKEN_NAME(TAT) TOKEN_NAME(TELLIPSIS)
+#undef TOKEN_NAME
+        default:
+            return "UNKNOWN";
+    }
+}
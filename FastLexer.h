@@ -0,0 +1,38 @@
+#ifndef FASTLEXER_H
+#define FASTLEXER_H
+
+#include <llvm/ADT/StringRef.h>
+
+#include <stddef.h>
+
+#include "ASTNodes.h"
+#include "grammar.hpp"
+
+//Hand-written scanner producing the same tokens and values as token.l.
+//Runs of whitespace, comments, identifiers, numbers and literals are
+//classified 32 bytes at a time with AVX2, 16 with SSE2, or bytewise when
+//neither is enabled at build time; keywords are found with a perfect hash.
+class FastLexer{
+private:
+    const char* cursor;
+    const char* end;
+    const char* tokenStart;
+
+public:
+    FastLexer(const char* source, size_t length)
+        : cursor(source), end(source + length), tokenStart(source){}
+
+    //The next token, its value stored into value, or 0 at the end and on an
+    //unknown character (reported on stdout like the flex scanner does)
+    int next(YYSTYPE& value);
+
+    //The text of the token last returned
+    llvm::StringRef lexeme() const{
+        return llvm::StringRef(tokenStart, cursor - tokenStart);
+    }
+};
+
+//Name of a token of grammar.y ("TIDENTIFIER"), for -dump-tokens
+const char* tokenName(int token);
+
+#endif //FASTLEXER_H
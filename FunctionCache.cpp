@@ -0,0 +1,454 @@
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MD5.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <llvm/Transforms/Utils/ValueMapper.h>
+
+#include <atomic>
+#include <map>
+#include <set>
+
+#include "FunctionCache.h"
+#include "ObjGen.h"
+#include "Optimizer.h"
+#include "Profile.h"
+
+using namespace llvm;
+
+//Bump when the codegen output for an unchanged AST changes
+static const char* cacheFormat = "subc-function-cache-6";
+
+//What the code of a function depends on outside of its own AST
+struct FunctionDeps{
+    std::set<string> callees;
+    std::set<string> types;
+};
+
+static void hashBytes(MD5& hash, const void* data, size_t size){
+    hash.update(ArrayRef<uint8_t>((const uint8_t*)data, size));
+}
+
+static void hashInt(MD5& hash, uint64_t value){
+    hashBytes(hash, &value, sizeof(value));
+}
+
+//length prefixed, so that "ab"+"c" and "a"+"bc" differ
+static void hashString(MD5& hash, StringRef value){
+    hashInt(hash, value.size());
+    hash.update(value);
+}
+
+static void hashNode(const Node* node, MD5& hash, FunctionDeps& deps);
+
+template<typename List>
+static void hashList(const List& list, MD5& hash, FunctionDeps& deps){
+    hashInt(hash, list.size());
+    for(auto& item: list){
+        hashNode(item, hash, deps);
+    }
+}
+
+static void hashNode(const Node* node, MD5& hash, FunctionDeps& deps){
+    if( node == nullptr ){
+        hashString(hash, "null");
+        return;
+    }
+    hashString(hash, nodeKindName(node->getKind()));
+    switch( node->getKind() ){
+    case NodeKind::Integer:{
+        auto integer = cast<NInteger>(node);
+        hashInt(hash, integer->value);
+        break;
+    }
+    case NodeKind::Double:{
+        auto number = cast<NDouble>(node);
+        hashBytes(hash, &number->value, sizeof(number->value));
+        break;
+    }
+    case NodeKind::Identifier:{
+        auto identifier = cast<NIdentifier>(node);
+        hashString(hash, identifier->name.str());
+        hashInt(hash, identifier->isType);
+        hashInt(hash, identifier->isArray);
+        hashList(identifier->arraySize, hash, deps);
+        if( identifier->isType )
+            deps.types.insert(identifier->name.str().str());
+        break;
+    }
+    case NodeKind::MethodCall:{
+        auto call = cast<NMethodCall>(node);
+        hashNode(call->id, hash, deps);
+        hashList(call->arguments, hash, deps);
+        deps.callees.insert(call->id->name.str().str());
+        break;
+    }
+    case NodeKind::BinaryOperator:{
+        auto binary = cast<NBinaryOperator>(node);
+        hashInt(hash, binary->op);
+        hashNode(binary->lhs, hash, deps);
+        hashNode(binary->rhs, hash, deps);
+        break;
+    }
+    case NodeKind::Assignment:{
+        auto assignment = cast<NAssignment>(node);
+        hashNode(assignment->lhs, hash, deps);
+        hashNode(assignment->rhs, hash, deps);
+        break;
+    }
+    case NodeKind::Block:{
+        auto block = cast<NBlock>(node);
+        hashList(block->statements, hash, deps);
+        break;
+    }
+    case NodeKind::ExpressionStatement:{
+        auto statement = cast<NExpressionStatement>(node);
+        hashNode(statement->expression, hash, deps);
+        break;
+    }
+    case NodeKind::VariableDeclaration:{
+        auto declaration = cast<NVariableDeclaration>(node);
+        hashNode(declaration->type, hash, deps);
+        hashNode(declaration->id, hash, deps);
+        hashNode(declaration->assignmentExpr, hash, deps);
+        break;
+    }
+    case NodeKind::FunctionDeclaration:{
+        auto function = cast<NFunctionDeclaration>(node);
+        hashNode(function->type, hash, deps);
+        hashNode(function->id, hash, deps);
+        hashList(function->arguments, hash, deps);
+        hashNode(function->block, hash, deps);
+        hashInt(hash, function->isExternal);
+        hashInt(hash, function->isVariadic);
+        break;
+    }
+    case NodeKind::StructDeclaration:{
+        auto structDeclaration = cast<NStructDeclaration>(node);
+        hashNode(structDeclaration->name, hash, deps);
+        hashList(structDeclaration->members, hash, deps);
+        break;
+    }
+    case NodeKind::ReturnStatement:{
+        auto returnStatement = cast<NReturnStatement>(node);
+        hashNode(returnStatement->expression, hash, deps);
+        break;
+    }
+    case NodeKind::IfStatement:{
+        auto ifStatement = cast<NIfStatement>(node);
+        hashNode(ifStatement->condition, hash, deps);
+        hashNode(ifStatement->trueBlock, hash, deps);
+        hashNode(ifStatement->falseBlock, hash, deps);
+        break;
+    }
+    case NodeKind::ForStatement:{
+        auto forStatement = cast<NForStatement>(node);
+        hashNode(forStatement->initial, hash, deps);
+        hashNode(forStatement->condition, hash, deps);
+        hashNode(forStatement->increment, hash, deps);
+        hashNode(forStatement->block, hash, deps);
+        hashInt(hash, forStatement->hints.flags);
+        hashInt(hash, forStatement->hints.vectorizeWidth);
+        hashInt(hash, forStatement->hints.interleaveCount);
+        hashInt(hash, forStatement->hints.unrollCount);
+        break;
+    }
+    case NodeKind::StructMember:{
+        auto member = cast<NStructMember>(node);
+        hashNode(member->id, hash, deps);
+        hashNode(member->member, hash, deps);
+        break;
+    }
+    case NodeKind::ArrayIndex:{
+        auto index = cast<NArrayIndex>(node);
+        hashNode(index->arrayName, hash, deps);
+        hashList(index->expressions, hash, deps);
+        break;
+    }
+    case NodeKind::ArrayAssignment:{
+        auto arrayAssignment = cast<NArrayAssignment>(node);
+        hashNode(arrayAssignment->arrayIndex, hash, deps);
+        hashNode(arrayAssignment->expression, hash, deps);
+        break;
+    }
+    case NodeKind::ArrayInitialization:{
+        auto initialization = cast<NArrayInitialization>(node);
+        hashNode(initialization->declaration, hash, deps);
+        hashList(initialization->expressionList, hash, deps);
+        break;
+    }
+    case NodeKind::StructAssignment:{
+        auto structAssignment = cast<NStructAssignment>(node);
+        hashNode(structAssignment->structMember, hash, deps);
+        hashNode(structAssignment->expression, hash, deps);
+        break;
+    }
+    case NodeKind::Literal:{
+        auto literal = cast<NLiteral>(node);
+        hashString(hash, literal->value.str());
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+static string typeString(const NIdentifier& type){
+    string result = type.name.str().str();
+    for(auto& size: type.arraySize){
+        auto integer = dyn_cast<NInteger>(size);
+        result += "[" + (integer ? std::to_string(integer->value) : string()) + "]";
+    }
+    return result;
+}
+
+static string signatureOf(const NFunctionDeclaration& function){
+    string signature = typeString(*function.type) + "(";
+    for(auto& arg: function.arguments){
+        signature += typeString(*arg->type) + ",";
+    }
+    return signature + (function.isVariadic ? "...)" : ")");
+}
+
+//Member types and names of a struct and, recursively, of the structs it contains
+static void hashStructLayout(const string& name, const std::map<string, NStructDeclaration*>& structs, MD5& hash, std::set<string>& visited){
+    auto it = structs.find(name);
+    if( it == structs.end() || !visited.insert(name).second )
+        return;
+    hashString(hash, name);
+    hashInt(hash, it->second->members.size());
+    for(auto& member: it->second->members){
+        hashString(hash, typeString(*member->type));
+        hashString(hash, member->id->name.str());
+        hashStructLayout(member->type->name.str().str(), structs, hash, visited);
+    }
+}
+
+//Everything besides the AST that changes the optimized code of a function
+static string flagsOf(TargetMachine* targetMachine, const CompilerOptions& options){
+    string flags;
+    raw_string_ostream out(flags);
+    out << cacheFormat << " llvm-" << LLVM_VERSION_STRING
+        << " " << targetMachine->getTargetTriple().str()
+        << " cpu=" << targetMachine->getTargetCPU()
+        << " features=" << targetMachine->getTargetFeatureString()
+        << " O" << options.optLevel << " s" << options.sizeLevel
+        << " reloc=" << options.relocModel << " cmodel=" << options.codeModel
+        << " ssa=" << options.ssaLocals;
+    return out.str();
+}
+
+static string keyOf(const NFunctionDeclaration& function, const std::map<string, string>& signatures,
+                    const std::map<string, NStructDeclaration*>& structs, const string& flags){
+    MD5 hash;
+    FunctionDeps deps;
+    hashString(hash, flags);
+    hashNode(&function, hash, deps);
+
+    for(auto& callee: deps.callees){
+        auto it = signatures.find(callee);
+        hashString(hash, callee);
+        hashString(hash, it == signatures.end() ? "undeclared" : it->second);
+    }
+
+    std::set<string> visited;
+    for(auto& type: deps.types){
+        hashStructLayout(type, structs, hash, visited);
+    }
+
+    MD5::MD5Result result;
+    hash.final(result);
+    return result.digest().str().str();
+}
+
+static void collectGlobals(const Value* value, std::set<const GlobalValue*>& globals){
+    if( auto global = dyn_cast<GlobalVariable>(value) ){
+        globals.insert(global);
+    }else if( auto expression = dyn_cast<ConstantExpr>(value) ){
+        for(auto& operand: expression->operands()){
+            collectGlobals(operand.get(), globals);
+        }
+    }
+}
+
+//A copy of the module holding only the body of one function, the globals
+//(string literals) it refers to and declarations for everything else
+static std::unique_ptr<Module> extractFunction(Module& module, Function* function){
+    std::set<const GlobalValue*> needed;
+    needed.insert(function);
+    for(auto& block: *function){
+        for(auto& instruction: block){
+            for(auto& operand: instruction.operands()){
+                collectGlobals(operand.get(), needed);
+            }
+        }
+    }
+
+    ValueToValueMapTy valueMap;
+    auto extracted = CloneModule(&module, valueMap, [&](const GlobalValue* global){
+        return needed.count(global) > 0;
+    });
+
+    //the literals of the other functions are left behind as unused declarations
+    for(auto it = extracted->global_begin(); it != extracted->global_end(); ){
+        GlobalVariable& global = *it++;
+        if( global.isDeclaration() && global.use_empty() )
+            global.eraseFromParent();
+    }
+    return extracted;
+}
+
+FunctionCache::FunctionCache(const string& directory)
+        : directory(directory), hits(0), misses(0){
+    sys::fs::create_directories(directory);
+}
+
+static string entryPath(const string& directory, const string& key){
+    SmallString<256> path(directory);
+    sys::path::append(path, key + ".bc");
+    return path.str().str();
+}
+
+static std::unique_ptr<Module> loadEntry(const string& path, LLVMContext& context){
+    auto buffer = MemoryBuffer::getFile(path);
+    if( !buffer )
+        return nullptr;
+    auto module = parseBitcodeFile((*buffer)->getMemBufferRef(), context);
+    if( !module ){
+        consumeError(module.takeError());
+        return nullptr;
+    }
+    return std::move(*module);
+}
+
+//A full disk or a read-only cache directory fails every store the same way,
+//the workers say it once between them
+static void warnStoreFailed(const string& path, const string& reason){
+    static std::atomic<bool> warned(false);
+    if( !warned.exchange(true) )
+        errs() << "function cache: cannot store " << path << ": " << reason << ", functions are not cached\n";
+}
+
+//Write through a temporary file and rename it, so that a concurrent reader
+//never sees half an entry
+static void storeEntry(const string& path, Module& module){
+    int fd;
+    SmallString<256> temporary;
+    if( std::error_code error = sys::fs::createUniqueFile(path + ".%%%%%%.tmp", fd, temporary) ){
+        warnStoreFailed(path, error.message());
+        return;
+    }
+    {
+        raw_fd_ostream out(fd, true);
+        WriteBitcodeToFile(&module, out);
+        out.close();
+        if( out.has_error() ){
+            //cleared, or the stream aborts the compiler when it is destroyed
+            out.clear_error();
+            warnStoreFailed(path, "write error");
+            sys::fs::remove(temporary);
+            return;
+        }
+    }
+    if( std::error_code error = sys::fs::rename(temporary, path) ){
+        warnStoreFailed(path, error.message());
+        sys::fs::remove(temporary);
+    }
+}
+
+bool FunctionCache::generateCode(NBlock& root, CodeGenContext& context, TargetMachine* targetMachine, const CompilerOptions& options){
+    std::map<string, string> signatures;
+    std::map<string, NStructDeclaration*> structs;
+    std::vector<NFunctionDeclaration*> functions;
+
+    for(auto& statement: root.statements){
+        if( auto function = dyn_cast<NFunctionDeclaration>(statement) ){
+            signatures[function->id->name.str().str()] = signatureOf(*function);
+            if( !function->isExternal )
+                functions.push_back(function);
+        }else if( auto structDeclaration = dyn_cast<NStructDeclaration>(statement) ){
+            structs[structDeclaration->name->name.str().str()] = structDeclaration;
+        }
+    }
+
+    //Pull the cached functions in first, their bodies are then not generated at all
+    string flags = flagsOf(targetMachine, options);
+    std::map<string, string> paths;
+    std::map<string, std::unique_ptr<Module>> cached;
+    {
+        PhaseTimer timer("cache load");
+        for(auto function: functions){
+            string name = function->id->name.str().str();
+            paths[name] = entryPath(directory, keyOf(*function, signatures, structs, flags));
+            if( auto module = loadEntry(paths[name], context.llvmContext) ){
+                cached[name] = std::move(module);
+                context.declarationOnly.insert(function->id->name);
+            }
+        }
+    }
+
+    {
+        PhaseTimer timer("codegen");
+        context.generateCode(root);
+    }
+
+    Module& module = *context.theModule;
+    module.setDataLayout(targetMachine->createDataLayout());
+    module.setTargetTriple(targetMachine->getTargetTriple().str());
+
+    auto linked = std::unique_ptr<Module>(new Module("main", context.llvmContext));
+    linked->setDataLayout(module.getDataLayout());
+    linked->setTargetTriple(module.getTargetTriple());
+    Linker linker(*linked);
+
+    bool succeeded = true;
+    for(auto function: functions){
+        string name = function->id->name.str().str();
+        std::unique_ptr<Module> functionModule;
+
+        auto it = cached.find(name);
+        if( it != cached.end() ){
+            hits++;
+            functionModule = std::move(it->second);
+        }else{
+            misses++;
+            functionModule = extractFunction(module, module.getFunction(name));
+            if( !prepareModule(*functionModule, targetMachine, options) ){
+                errs() << "Function " << name << " is broken, not cached\n";
+                succeeded = false;
+                continue;
+            }
+            storeEntry(paths[name], *functionModule);
+        }
+
+        if( linker.linkInModule(std::move(functionModule)) ){
+            errs() << "Cannot link function " << name << "\n";
+            succeeded = false;
+        }
+    }
+
+    //every entry was optimized alone, with its callees only declared; inline
+    //them now that the bodies are together. This is redone on every build and
+    //never cached, an entry stays valid while the bodies of its callees change
+    if( succeeded )
+        inlineAcrossFunctions(*linked, targetMachine, options.optLevel, options.sizeLevel);
+
+    context.theModule = std::move(linked);
+    return succeeded;
+}
+
+void FunctionCache::printStats() const{
+    uint64_t hitCount = hits, missCount = misses;
+    uint64_t total = hitCount + missCount;
+    errs() << "function cache: " << hitCount << " hits, " << missCount << " misses";
+    if( total )
+        errs() << " (" << (hitCount * 100 / total) << "% hit rate)";
+    errs() << "\n";
+}
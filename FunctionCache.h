@@ -0,0 +1,38 @@
+#ifndef FUNCTIONCACHE_H
+#define FUNCTIONCACHE_H
+
+#include <llvm/Target/TargetMachine.h>
+
+#include <atomic>
+#include <string>
+
+#include "ASTNodes.h"
+#include "CodeGen.h"
+#include "Options.h"
+
+//On-disk cache of optimized bitcode, one entry per function.
+//
+//The key of a function hashes its AST, the signatures of the functions it
+//calls, the layouts of the structs it uses and the target/optimization flags.
+//Every function is optimized in a module of its own, so its code never
+//depends on the body of another function and an entry stays valid as long
+//as its key does.
+class FunctionCache{
+private:
+    std::string directory;
+
+public:
+    std::atomic<uint64_t> hits;
+    std::atomic<uint64_t> misses;
+
+    explicit FunctionCache(const std::string& directory);
+
+    //Generate the program into context.theModule, regenerating only the
+    //functions whose key is not in the cache. The resulting module is already
+    //optimized and prepared for targetMachine, it only needs the backend.
+    bool generateCode(NBlock& root, CodeGenContext& context, llvm::TargetMachine* targetMachine, const CompilerOptions& options);
+
+    void printStats() const;
+};
+
+#endif //FUNCTIONCACHE_H
@@ -0,0 +1,91 @@
+#include <llvm/ExecutionEngine/Orc/LambdaResolver.h>
+#include <llvm/ExecutionEngine/RTDyldMemoryManager.h>
+#include <llvm/ExecutionEngine/SectionMemoryManager.h>
+#include <llvm/IR/Mangler.h>
+#include <llvm/Support/DynamicLibrary.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <stdio.h>
+
+#include "JIT.h"
+#include "ObjGen.h"
+#include "Profile.h"
+
+using namespace llvm;
+using namespace llvm::orc;
+
+SubCJIT::SubCJIT(TargetMachine* targetMachine)
+        : targetMachine(targetMachine), dataLayout(targetMachine->createDataLayout()),
+          objectLayer([]() { return std::make_shared<SectionMemoryManager>(); }),
+          compileLayer(objectLayer, SimpleCompiler(*targetMachine)){
+    //Make the symbols of the compiler process itself (libc included) visible to the resolver
+    sys::DynamicLibrary::LoadLibraryPermanently(nullptr);
+}
+
+SubCJIT::ModuleHandle SubCJIT::addModule(std::unique_ptr<Module> module){
+    //Look in the JIT first, then fall back to the host process for the extern functions
+    auto resolver = createLambdaResolver(
+        [this](const std::string& name){
+            if( auto symbol = this->compileLayer.findSymbol(name, false) )
+                return symbol;
+            return JITSymbol(nullptr);
+        },
+        [](const std::string& name){
+            if( auto address = RTDyldMemoryManager::getSymbolAddressInProcess(name) )
+                return JITSymbol(address, JITSymbolFlags::Exported);
+            return JITSymbol(nullptr);
+        });
+    return cantFail(compileLayer.addModule(std::move(module), std::move(resolver)));
+}
+
+JITSymbol SubCJIT::findSymbol(const std::string& name){
+    std::string mangledName;
+    raw_string_ostream mangledNameStream(mangledName);
+    Mangler::getNameWithPrefix(mangledNameStream, name, dataLayout);
+    return compileLayer.findSymbol(mangledNameStream.str(), true);
+}
+
+int runJIT(CodeGenContext& context, const CompilerOptions& options){
+    doInit();
+
+    Function* mainFunction = context.theModule->getFunction("main");
+    if( !mainFunction || mainFunction->isDeclaration() ){
+        errs() << "No main function to run\n";
+        return -1;
+    }
+    FunctionType* mainType = mainFunction->getFunctionType();
+    if( !mainType->getReturnType()->isIntegerTy(32) || mainType->getNumParams() != 0 ){
+        errs() << "main must be declared as int main()\n";
+        return -1;
+    }
+
+    std::unique_ptr<TargetMachine> targetMachine(createTargetMachine(options, true));
+    if( !targetMachine ){
+        return -1;
+    }
+
+    if( !prepareModule(*context.theModule, targetMachine.get(), options) )
+        return -1;
+
+    //the JIT owns the TargetMachine from here on
+    SubCJIT jit(targetMachine.release());
+    JITTargetAddress mainAddress;
+    {
+        //the module is compiled lazily, when main is looked up
+        PhaseTimer timer("jit");
+        jit.addModule(std::move(context.theModule));
+
+        auto mainSymbol = jit.findSymbol("main");
+        if( !mainSymbol ){
+            errs() << "main was not emitted by the JIT\n";
+            return -1;
+        }
+        mainAddress = cantFail(mainSymbol.getAddress());
+    }
+    auto mainPtr = (int (*)())(intptr_t)mainAddress;
+
+    int result = mainPtr();
+    //The program wrote through the libc of this process, flush it before the compiler exits
+    fflush(stdout);
+    return result;
+}
@@ -0,0 +1,46 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <llvm/ExecutionEngine/JITSymbol.h>
+#include <llvm/ExecutionEngine/Orc/CompileUtils.h>
+#include <llvm/ExecutionEngine/Orc/IRCompileLayer.h>
+#include <llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h>
+#include <llvm/IR/DataLayout.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Target/TargetMachine.h>
+
+#include <memory>
+#include <string>
+
+#include "CodeGen.h"
+#include "Options.h"
+
+//In-process ORC JIT: the module is compiled straight into memory and
+//extern declarations such as printf/puts resolve against the host process
+class SubCJIT{
+public:
+    using ObjectLayer = llvm::orc::RTDyldObjectLinkingLayer;
+    using CompileLayer = llvm::orc::IRCompileLayer<ObjectLayer, llvm::orc::SimpleCompiler>;
+    using ModuleHandle = CompileLayer::ModuleHandleT;
+
+private:
+    std::unique_ptr<llvm::TargetMachine> targetMachine;
+    const llvm::DataLayout dataLayout;
+    ObjectLayer objectLayer;
+    CompileLayer compileLayer;
+
+public:
+    explicit SubCJIT(llvm::TargetMachine* targetMachine);
+
+    llvm::TargetMachine* getTargetMachine() { return targetMachine.get(); }
+
+    ModuleHandle addModule(std::unique_ptr<llvm::Module> module);
+
+    llvm::JITSymbol findSymbol(const std::string& name);
+};
+
+//Optimize the module of the context, hand it to the JIT and call its main.
+//Returns the value main returned, or -1 when it could not be run.
+int runJIT(CodeGenContext& context, const CompilerOptions& options);
+
+#endif //JIT_H
@@ -0,0 +1,92 @@
+#include <llvm/Support/MathExtras.h>
+
+#include "LoopHints.h"
+
+using namespace llvm;
+
+//The loop vectorizer ignores a width over 64 or an interleave count over 16
+//that is not a power of two, better to say so than to drop the hint quietly
+static bool checkCount(StringRef name, uint64_t value, uint64_t limit, bool powerOfTwo, std::string& error){
+    if( value == 0 || value > limit ){
+        error = "@" + name.str() + " takes a count from 1 to " + std::to_string(limit);
+        return false;
+    }
+    if( powerOfTwo && !isPowerOf2_64(value) ){
+        error = "@" + name.str() + " takes a power of two";
+        return false;
+    }
+    return true;
+}
+
+bool LoopHints::set(StringRef name, uint64_t value, bool hasValue, std::string& error){
+    uint8_t flag;
+    uint8_t opposite = 0;
+    if( name == "vectorize" ){
+        if( hasValue && !checkCount(name, value, 64, true, error) )
+            return false;
+        flag = Vectorize;
+        opposite = NoVectorize;
+    }else if( name == "interleave" ){
+        if( !hasValue ){
+            error = "@interleave takes a count";
+            return false;
+        }
+        if( !checkCount(name, value, 16, true, error) )
+            return false;
+        interleaveCount = value;
+        return true;
+    }else if( name == "unroll" ){
+        if( hasValue && !checkCount(name, value, UINT16_MAX, false, error) )
+            return false;
+        flag = Unroll;
+        opposite = NoUnroll;
+    }else if( name == "novectorize" ){
+        flag = NoVectorize;
+        opposite = Vectorize;
+    }else if( name == "nounroll" ){
+        flag = NoUnroll;
+        opposite = Unroll;
+    }else if( name == "independent" ){
+        flag = Independent;
+    }else{
+        error = "unknown loop hint @" + name.str();
+        return false;
+    }
+
+    if( hasValue && flag != Vectorize && flag != Unroll ){
+        error = "@" + name.str() + " takes no count";
+        return false;
+    }
+    if( flags & opposite ){
+        error = "@" + name.str() + " contradicts an earlier loop hint";
+        return false;
+    }
+    flags |= flag;
+    if( hasValue && flag == Vectorize )
+        vectorizeWidth = value;
+    if( hasValue && flag == Unroll )
+        unrollCount = value;
+    return true;
+}
+
+void LoopHints::print(raw_ostream& out) const{
+    const char* separator = "";
+    auto hint = [&](const char* name, unsigned count){
+        out << separator << '@' << name;
+        if( count )
+            out << '(' << count << ')';
+        separator = " ";
+    };
+    if( flags & Vectorize )
+        hint("vectorize", vectorizeWidth);
+    if( flags & NoVectorize )
+        hint("novectorize", 0);
+    if( interleaveCount )
+        hint("interleave", interleaveCount);
+    if( flags & Unroll )
+        hint("unroll", unrollCount);
+    if( flags & NoUnroll )
+        hint("nounroll", 0);
+    if( flags & Independent )
+        hint("independent", 0);
+}
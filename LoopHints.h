@@ -0,0 +1,46 @@
+#ifndef LOOPHINTS_H
+#define LOOPHINTS_H
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <stdint.h>
+#include <string>
+
+//The annotations written in front of a for or while:
+//
+//    @vectorize @vectorize(N) @novectorize @interleave(N)
+//    @unroll @unroll(N) @nounroll @independent
+//
+//Codegen turns them into the llvm.loop metadata of the latch branch, a count
+//of 0 leaves the choice to the optimizer.
+struct LoopHints{
+    enum Flags : uint8_t{
+        Vectorize = 1,
+        NoVectorize = 2,
+        Unroll = 4,
+        NoUnroll = 8,
+        //no iteration depends on memory another one writes
+        Independent = 16,
+        AllFlags = 31,
+    };
+
+    uint16_t vectorizeWidth = 0;
+    uint16_t interleaveCount = 0;
+    uint16_t unrollCount = 0;
+    uint8_t flags = 0;
+
+    bool empty() const{
+        return flags == 0 && vectorizeWidth == 0 && interleaveCount == 0 && unrollCount == 0;
+    }
+
+    //Add @name, or @name(value) when hasValue. False with the reason in error
+    //for an unknown name, a count out of range or a hint that contradicts one
+    //given before.
+    bool set(llvm::StringRef name, uint64_t value, bool hasValue, std::string& error);
+
+    //The hints as they are written, "@vectorize(4) @unroll"
+    void print(llvm::raw_ostream& out) const;
+};
+
+#endif //LOOPHINTS_H
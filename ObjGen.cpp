@@ -1,10 +1,14 @@
 #include <llvm/Support/FileSystem.h>
 #include <llvm/Support/Host.h>
 #include <llvm/ADT/Optional.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/Support/FormattedStream.h>
 #include <llvm/Support/FileSystem.h>
 #include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/MC/SubtargetFeature.h>
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/Support/TargetRegistry.h>
 #include <llvm/Support/TargetSelect.h>
@@ -13,9 +17,85 @@
 
 #include "CodeGen.h"
 #include "ObjGen.h"
+#include "Optimizer.h"
+#include "Profile.h"
 
 using namespace llvm;
 
+static CodeGenOpt::Level codeGenOptLevel(unsigned optLevel){
+    switch (optLevel){
+        case 0:
+            return CodeGenOpt::None;
+        case 1:
+            return CodeGenOpt::Less;
+        case 2:
+            return CodeGenOpt::Default;
+        default:
+            return CodeGenOpt::Aggressive;
+    }
+}
+
+static Optional<Reloc::Model> relocModel(const string& name){
+    if( name == "static" )
+        return Reloc::Static;
+    if( name == "pic" )
+        return Reloc::PIC_;
+    if( name == "dynamic-no-pic" )
+        return Reloc::DynamicNoPIC;
+    // empty: let the target pick its default
+    return None;
+}
+
+static Optional<CodeModel::Model> codeModel(const string& name){
+    if( name == "small" )
+        return CodeModel::Small;
+    if( name == "kernel" )
+        return CodeModel::Kernel;
+    if( name == "medium" )
+        return CodeModel::Medium;
+    if( name == "large" )
+        return CodeModel::Large;
+    return None;
+}
+
+//Resolve -mcpu/-march=native into a concrete cpu name
+static string targetCPU(const CompilerOptions& options){
+    if( options.cpu == "native" )
+        return sys::getHostCPUName().str();
+    return options.cpu.empty() ? "generic" : options.cpu;
+}
+
+//The host feature list for -march=native, followed by the explicit -mattr list so it can override
+static string targetFeatures(const CompilerOptions& options){
+    SubtargetFeatures features;
+    if( options.cpu == "native" ){
+        StringMap<bool> hostFeatures;
+        if( sys::getHostCPUFeatures(hostFeatures) ){
+            for(auto& feature: hostFeatures){
+                features.AddFeature(feature.first(), feature.second);
+            }
+        }
+    }
+    if( !options.features.empty() ){
+        SubtargetFeatures explicitFeatures(options.features);
+        for(auto& feature: explicitFeatures.getFeatures()){
+            features.AddFeature(feature);
+        }
+    }
+    return features.getString();
+}
+
+//The middle-end reads the subtarget of each function from its attributes, not from the
+//TargetMachine, so the vectorizers only see the real vector width once these are set
+static void setFunctionTargetAttributes(Module& module, StringRef CPU, StringRef features){
+    for(auto& function: module){
+        if( function.isDeclaration() )
+            continue;
+        function.addFnAttr("target-cpu", CPU);
+        if( !features.empty() )
+            function.addFnAttr("target-features", features);
+    }
+}
 
 void doInit(){
     // The function here is just a routine of the llvm
@@ -27,46 +107,93 @@ void doInit(){
     InitializeAllAsmPrinters();
 }
 
-void ObjGen(CodeGenContext & context, const string& filename){
-    doInit();
+TargetMachine* createTargetMachine(const CompilerOptions& options, bool forJIT){
     auto targetTriple = sys::getDefaultTargetTriple();
-    context.theModule->setTargetTriple(targetTriple);
 
     std::string error;
     auto Target = TargetRegistry::lookupTarget(targetTriple, error);
 
     if( !Target ){
         errs() << error;
-        return;
+        return nullptr;
     }
 
     TargetOptions tOptions;
-    auto RM = Optional<Reloc::Model>();
+    auto RM = relocModel(options.relocModel);
+    auto CM = codeModel(options.codeModel);
 
-    const char* features = "";
-    const char* CPU = "generic";
+    string CPU = targetCPU(options);
+    string features = targetFeatures(options);
+
+    return Target->createTargetMachine(targetTriple, CPU, features, tOptions, RM, CM, codeGenOptLevel(options.optLevel), forJIT);
+}
 
-    llvm::TargetMachine* theTargetMachine = Target->createTargetMachine(targetTriple, CPU, features, tOptions, RM);
+bool prepareModule(Module& module, TargetMachine* targetMachine, const CompilerOptions& options, raw_ostream& diagnostics){
+    module.setDataLayout(targetMachine->createDataLayout());
+    module.setTargetTriple(targetMachine->getTargetTriple().str());
+    setFunctionTargetAttributes(module, targetMachine->getTargetCPU(), targetMachine->getTargetFeatureString());
+
+    //The passes and the backend assume well formed IR, a broken module is
+    //better reported than crashed on or emitted
+    {
+        PhaseTimer timer("verify");
+        if( verifyModule(module, &diagnostics) ){
+            diagnostics << "Module is broken, nothing is emitted\n";
+            return false;
+        }
+    }
 
-    context.theModule->setDataLayout(theTargetMachine->createDataLayout());
-    context.theModule->setTargetTriple(targetTriple);
+    PhaseTimer timer("optimize");
+    optimizeModule(module, targetMachine, options.optLevel, options.sizeLevel, options.loopHintReport);
+    return true;
+}
 
-    std::error_code ErrorCode;
-    raw_fd_ostream dest(filename.c_str(), ErrorCode, sys::fs::F_None);
+bool emitOutput(Module& module, TargetMachine* targetMachine, OutputKind kind, raw_pwrite_stream& dest){
+    PhaseTimer timer("emit");
+    if( kind == OutputKind::LLVMIR ){
+        module.print(dest, nullptr);
+        dest.flush();
+        return true;
+    }
+    if( kind == OutputKind::Bitcode ){
+        WriteBitcodeToFile(&module, dest);
+        dest.flush();
+        return true;
+    }
 
     legacy::PassManager pass;
-    auto fileType = TargetMachine::CGFT_ObjectFile;
+    auto fileType = kind == OutputKind::Assembly ? TargetMachine::CGFT_AssemblyFile : TargetMachine::CGFT_ObjectFile;
 
-    if( theTargetMachine->addPassesToEmitFile(pass, dest, fileType) ){
+    if( targetMachine->addPassesToEmitFile(pass, dest, fileType) ){
         errs() << "This Type can't be emited";
-        return;
+        return false;
     }
-    pass.run(*context.theModule.get());
+    pass.run(module);
     dest.flush();
+    return true;
+}
+
+bool ObjGen(CodeGenContext & context, const CompilerOptions& options, const string& filename){
+    doInit();
+
+    std::unique_ptr<llvm::TargetMachine> theTargetMachine(createTargetMachine(options));
+    if( !theTargetMachine ){
+        return false;
+    }
+
+    if( !prepareModule(*context.theModule, theTargetMachine.get(), options) ){
+        return false;
+    }
+
+    std::error_code ErrorCode;
+    raw_fd_ostream dest(filename.c_str(), ErrorCode, sys::fs::F_None);
+    if( ErrorCode ){
+        errs() << filename << ": " << ErrorCode.message() << "\n";
+        return false;
+    }
 
     //commit this to get the clean output
     //outs() << "Write OBJ code to : " << filename.c_str() << "\n";
 
-    return;
+    return emitOutput(*context.theModule, theTargetMachine.get(), options.emit, dest);
 }
-
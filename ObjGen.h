@@ -1,7 +1,22 @@
 #ifndef OBJGEN_H
 #define OBJGEN_H
 
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetMachine.h>
+#include "Options.h"
+
 void doInit();
-void ObjGen(CodeGenContext & context, const string& filename = "output.o");
+//A TargetMachine for the host triple honoring -mcpu/-march/-mattr, the relocation and code model
+llvm::TargetMachine* createTargetMachine(const CompilerOptions& options, bool forJIT = false);
+//Stamp the target onto the module and its functions, verify it, then run the
+//-O pipeline. False when the module is broken and must not be emitted, the
+//verifier's complaints are then on diagnostics.
+bool prepareModule(llvm::Module& module, llvm::TargetMachine* targetMachine, const CompilerOptions& options,
+                   llvm::raw_ostream& diagnostics = llvm::errs());
+//Write a prepared module to dest as an object file, assembly (both through the
+//backend of targetMachine), textual IR or bitcode
+bool emitOutput(llvm::Module& module, llvm::TargetMachine* targetMachine, OutputKind kind, llvm::raw_pwrite_stream& dest);
+//False when no output was written, the reason is on stderr
+bool ObjGen(CodeGenContext & context, const CompilerOptions& options, const string& filename = "output.o");
 
 #endif 
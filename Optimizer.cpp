@@ -0,0 +1,228 @@
+#include <llvm/ADT/Triple.h>
+#include <llvm/Analysis/TargetLibraryInfo.h>
+#include <llvm/Analysis/TargetTransformInfo.h>
+#include <llvm/IR/DiagnosticHandler.h>
+#include <llvm/IR/DiagnosticInfo.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IR/Metadata.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Transforms/IPO.h>
+#include <llvm/Transforms/IPO/AlwaysInliner.h>
+#include <llvm/Transforms/IPO/PassManagerBuilder.h>
+#include <llvm/Transforms/Scalar.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Optimizer.h"
+#include "Profile.h"
+
+using namespace llvm;
+
+namespace {
+
+//What the loop passes say about a function, in the order they said it
+typedef std::map<std::string, std::vector<std::string>> RemarksByFunction;
+
+//Takes the remarks of the loop vectorizer and unroller, the other
+//diagnostics go on to the default handler
+class LoopRemarkCollector: public DiagnosticHandler{
+private:
+    RemarksByFunction& remarks;
+
+    static bool isLoopPass(StringRef pass){
+        return pass == "loop-vectorize" || pass == "loop-unroll";
+    }
+
+public:
+    LoopRemarkCollector(RemarksByFunction& remarks) : remarks(remarks){}
+
+    bool isAnalysisRemarkEnabled(StringRef pass) const override{
+        return isLoopPass(pass);
+    }
+    bool isMissedOptRemarkEnabled(StringRef pass) const override{
+        return isLoopPass(pass);
+    }
+    bool isPassedOptRemarkEnabled(StringRef pass) const override{
+        return isLoopPass(pass);
+    }
+
+    bool handleDiagnostics(const DiagnosticInfo& info) override{
+        auto remark = dyn_cast<DiagnosticInfoIROptimization>(&info);
+        if( !remark )
+            return false;
+        //a hint that cannot be honoured comes as a warning without a pass
+        StringRef pass = remark->getPassName();
+        if( pass.empty() )
+            pass = info.getSeverity() == DS_Warning ? "warning" : "remark";
+        remarks[remark->getFunction().getName().str()].push_back(pass.str() + ": " + remark->getMsg());
+        //warnings are still printed as usual
+        return info.getSeverity() != DS_Warning;
+    }
+};
+
+//-Rloop-hints over one run of a pipeline. Made before the pipeline, it notes
+//the llvm.loop hints of each function and collects the loop remarks; when it
+//goes it prints both per function to stderr and puts the handler back.
+class LoopHintReport{
+private:
+    Module& module;
+    bool enabled;
+    bool optimized;
+    RemarksByFunction hints;
+    RemarksByFunction remarks;
+    std::unique_ptr<DiagnosticHandler> previous;
+
+    static void describeLoopID(const MDNode* loopID, raw_ostream& out){
+        for(unsigned i=1; i<loopID->getNumOperands(); i++){
+            auto property = dyn_cast_or_null<MDNode>(loopID->getOperand(i).get());
+            if( !property || property->getNumOperands() == 0 || !isa<MDString>(property->getOperand(0)) )
+                continue;
+            out << ' ' << cast<MDString>(property->getOperand(0))->getString();
+            if( property->getNumOperands() > 1 ){
+                if( auto value = mdconst::dyn_extract<ConstantInt>(property->getOperand(1)) )
+                    out << '=' << value->getZExtValue();
+            }
+        }
+    }
+
+public:
+    LoopHintReport(Module& module, bool enabled, bool optimized)
+        : module(module), enabled(enabled), optimized(optimized){
+        if( !enabled )
+            return;
+        for(auto& function: module){
+            unsigned loops = 0;
+            for(auto& block: function){
+                auto terminator = block.getTerminator();
+                MDNode* loopID = terminator ? terminator->getMetadata(LLVMContext::MD_loop) : nullptr;
+                if( !loopID )
+                    continue;
+                std::string text;
+                raw_string_ostream out(text);
+                //codegen branches back to the header first
+                BasicBlock* header = terminator->getSuccessor(0);
+                out << "loop " << ++loops;
+                if( header->hasName() )
+                    out << " (" << header->getName() << ')';
+                out << ':';
+                describeLoopID(loopID, out);
+                hints[function.getName().str()].push_back(out.str());
+            }
+        }
+        previous = module.getContext().getDiagnosticHandler();
+        module.getContext().setDiagnosticHandler(std::unique_ptr<DiagnosticHandler>(new LoopRemarkCollector(remarks)));
+    }
+
+    ~LoopHintReport(){
+        if( !enabled )
+            return;
+        module.getContext().setDiagnosticHandler(std::move(previous));
+        //one write per module, the workers of -j share stderr
+        std::string text;
+        raw_string_ostream out(text);
+        for(auto& function: hints){
+            out << "loop hints in '" << function.first << "' (" << module.getModuleIdentifier() << "):\n";
+            for(auto& line: function.second)
+                out << "  " << line << '\n';
+            if( !optimized )
+                out << "  not applied, the optimizer does not run at -O0\n";
+            for(auto& line: remarks[function.first])
+                out << "  " << line << '\n';
+        }
+        errs() << out.str();
+    }
+};
+
+}
+
+void optimizeModule(Module& module, TargetMachine* targetMachine, unsigned optLevel, unsigned sizeLevel, bool loopHintReport){
+    LoopHintReport report(module, loopHintReport, optLevel > 0 || sizeLevel > 0);
+    if( optLevel == 0 && sizeLevel == 0 ){
+        return;
+    }
+
+    // The same recipe as clang: the full inliner from -O2, the always-inliner below it
+    PassManagerBuilder builder;
+    builder.OptLevel = optLevel;
+    builder.SizeLevel = sizeLevel;
+    if( optLevel > 1 )
+        builder.Inliner = createFunctionInliningPass(optLevel, sizeLevel, false);
+    else
+        builder.Inliner = createAlwaysInlinerLegacyPass();
+    builder.LoopVectorize = optLevel > 1 && sizeLevel < 2;
+    builder.SLPVectorize = optLevel > 1 && sizeLevel < 2;
+    builder.LibraryInfo = new TargetLibraryInfoImpl(Triple(module.getTargetTriple()));
+    targetMachine->adjustPassManager(builder);
+
+    legacy::FunctionPassManager functionPasses(&module);
+    legacy::PassManager modulePasses;
+
+    //Without the target cost model the vectorizers see no vector registers at all
+    functionPasses.add(createTargetTransformInfoWrapperPass(targetMachine->getTargetIRAnalysis()));
+    modulePasses.add(createTargetTransformInfoWrapperPass(targetMachine->getTargetIRAnalysis()));
+
+    builder.populateFunctionPassManager(functionPasses);
+    builder.populateModulePassManager(modulePasses);
+
+    functionPasses.doInitialization();
+    for(auto& function: module){
+        PhaseTimer timer("optimize", function.getName());
+        functionPasses.run(function);
+    }
+    functionPasses.doFinalization();
+
+    modulePasses.run(module);
+}
+
+void inlineAcrossFunctions(Module& module, TargetMachine* targetMachine, unsigned optLevel, unsigned sizeLevel){
+    if( optLevel < 2 )
+        return;
+    PhaseTimer timer("inline");
+    legacy::PassManager passes;
+    passes.add(createTargetTransformInfoWrapperPass(targetMachine->getTargetIRAnalysis()));
+    passes.add(createFunctionInliningPass(optLevel, sizeLevel, false));
+    //the inlined bodies are optimized already, only the seams need work
+    passes.add(createInstructionCombiningPass());
+    passes.add(createEarlyCSEPass());
+    passes.add(createCFGSimplificationPass());
+    passes.run(module);
+}
+
+bool optimizeWholeProgram(Module& module, TargetMachine* targetMachine, unsigned optLevel, unsigned sizeLevel,
+                          const std::set<std::string>& exported, bool loopHintReport){
+    PhaseTimer timer("lto");
+    LoopHintReport report(module, loopHintReport, optLevel > 0 || sizeLevel > 0);
+    if( verifyModule(module, &errs()) ){
+        errs() << "Module is broken, nothing is emitted\n";
+        return false;
+    }
+
+    legacy::PassManager passes;
+    passes.add(createTargetTransformInfoWrapperPass(targetMachine->getTargetIRAnalysis()));
+
+    //Once nothing outside can call them, helpers are free to be inlined and removed.
+    //Declarations (printf, puts, ...) stay external, the system linker resolves them.
+    passes.add(createInternalizePass([&](const GlobalValue& global){
+        return global.isDeclaration() || exported.count(global.getName().str()) > 0;
+    }));
+    passes.add(createGlobalDCEPass());
+
+    if( optLevel > 0 || sizeLevel > 0 ){
+        PassManagerBuilder builder;
+        builder.OptLevel = optLevel;
+        builder.SizeLevel = sizeLevel;
+        builder.Inliner = createFunctionInliningPass(optLevel, sizeLevel, false);
+        builder.LoopVectorize = optLevel > 1 && sizeLevel < 2;
+        builder.SLPVectorize = optLevel > 1 && sizeLevel < 2;
+        builder.LibraryInfo = new TargetLibraryInfoImpl(Triple(module.getTargetTriple()));
+        targetMachine->adjustPassManager(builder);
+        builder.populateLTOPassManager(passes);
+    }
+
+    passes.run(module);
+    return true;
+}
@@ -0,0 +1,29 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include <llvm/IR/Module.h>
+#include <llvm/Target/TargetMachine.h>
+
+#include <set>
+#include <string>
+
+//Run the LLVM middle-end pipeline for the given level on the module.
+//The module must already carry the triple and data layout of targetMachine
+//and be verified (prepareModule does both). optLevel 0 with sizeLevel 0
+//leaves the module untouched. loopHintReport prints the llvm.loop hints of each function to stderr,
+//followed by the remarks of the loop vectorizer and unroller on them.
+void optimizeModule(llvm::Module& module, llvm::TargetMachine* targetMachine, unsigned optLevel, unsigned sizeLevel = 0,
+                    bool loopHintReport = false);
+
+//Inline across the functions of a module whose functions were optimized one
+//by one (the function cache), then clean up where calls were inlined. Below
+//-O2 there is no inliner, as in optimizeModule, and the module is untouched.
+void inlineAcrossFunctions(llvm::Module& module, llvm::TargetMachine* targetMachine, unsigned optLevel, unsigned sizeLevel = 0);
+
+//Link-time optimization of a merged program: internalize every symbol not in
+//exported, drop what became dead and run the interprocedural pipeline.
+//Returns false, after printing the verifier's complaints, for a broken module.
+bool optimizeWholeProgram(llvm::Module& module, llvm::TargetMachine* targetMachine, unsigned optLevel, unsigned sizeLevel,
+                          const std::set<std::string>& exported, bool loopHintReport = false);
+
+#endif //OPTIMIZER_H
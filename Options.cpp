@@ -0,0 +1,240 @@
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <initializer_list>
+#include <sstream>
+#include "Options.h"
+
+void printUsage(const char* program){
+    std::cerr << "Usage: " << program << " [options] [file...] (reads stdin when no file is given)" << std::endl
+              << "Options:" << std::endl
+              << "  -O0 -O1 -O2 -O3     optimization level (default -O0)" << std::endl
+              << "  -Os -Oz             optimize for size" << std::endl
+              << "  -o <file>           write the output to file" << std::endl
+              << "  -S                  emit native assembly (.s)" << std::endl
+              << "  -emit-llvm          emit textual LLVM IR (.ll)" << std::endl
+              << "  -emit-bc            emit LLVM bitcode (.bc)" << std::endl
+              << "  -emit-ast           parse only and write the binary AST (.ast), which" << std::endl
+              << "                      later compiles take in place of the source" << std::endl
+              << "  -f[no-]discard-value-names" << std::endl
+              << "                      drop the names of IR values (default in release builds)" << std::endl
+              << "  -fno-ast-passes     skip the passes over the AST that run before codegen" << std::endl
+              << "  -fno-ssa-locals     keep scalar locals in allocas, for mem2reg to promote" << std::endl
+              << "  -ftime-report       print wall and cpu time of every compiler phase" << std::endl
+              << "  -fmem-report        print allocations, peak RSS and AST node counts" << std::endl
+              << "  -ftime-trace=<file> write phases and functions as Chrome trace events" << std::endl
+              << "  -Rloop-hints        report which loop @hints the optimizer applied" << std::endl
+              << "  -lexer=<flex|fast>  scanner to use, fast classifies 16/32 bytes at a time" << std::endl
+              << "  -dump-tokens        print the tokens of the inputs and stop" << std::endl
+              << "  -lex-only           only scan the inputs, for timing the scanner" << std::endl
+              << "  -ast-dump[=text|json]" << std::endl
+              << "                      print the tree of the inputs to stdout and stop" << std::endl
+              << "  -march=<cpu>        same as -mcpu, -march=native targets the host" << std::endl
+              << "  -mcpu=<cpu>         cpu to tune and select instructions for" << std::endl
+              << "  -mattr=<+a,-b>      enable or disable target features" << std::endl
+              << "  -relocation-model=<static|pic|dynamic-no-pic>" << std::endl
+              << "  -mcmodel=<small|kernel|medium|large>" << std::endl
+              << "  -j <n>              compile the input files on n threads (default: all cores)" << std::endl
+              << "  --cache-dir=<dir>   reuse the optimized code of unchanged functions" << std::endl
+              << "  --whole-program     link all inputs into output.o and optimize them together" << std::endl
+              << "  --export=<a,b>      symbols besides main that --whole-program keeps external" << std::endl
+              << "  --jit               run main in process instead of writing output.o" << std::endl
+              << "  --daemon[=<socket>] keep LLVM warm and serve compile requests" << std::endl
+              << "                      on stdin/stdout or on a Unix socket" << std::endl
+              << "  -h, --help          print this message" << std::endl;
+}
+
+static bool parseOptLevel(const char* level, CompilerOptions& options){
+    if( strcmp(level, "0") == 0 || strcmp(level, "1") == 0 || strcmp(level, "2") == 0 || strcmp(level, "3") == 0 ){
+        options.optLevel = level[0] - '0';
+        options.sizeLevel = 0;
+        return true;
+    }
+    //-Os and -Oz keep the -O2 pipeline but tune the inliner and unroller for size
+    if( strcmp(level, "s") == 0 || strcmp(level, "z") == 0 ){
+        options.optLevel = 2;
+        options.sizeLevel = level[0] == 's' ? 1 : 2;
+        return true;
+    }
+    return false;
+}
+
+//Match "-name=value" and return the value part, nullptr otherwise
+static const char* optionValue(const char* arg, const char* name){
+    size_t length = strlen(name);
+    if( strncmp(arg, name, length) == 0 && arg[length] == '=' )
+        return arg + length + 1;
+    return nullptr;
+}
+
+static bool oneOf(const char* value, std::initializer_list<const char*> choices){
+    for(auto choice: choices){
+        if( strcmp(value, choice) == 0 )
+            return true;
+    }
+    return false;
+}
+
+bool parseOptions(int argc, char** argv, CompilerOptions& options){
+    for(int i=1; i<argc; i++){
+        const char* arg = argv[i];
+        if( strncmp(arg, "-O", 2) == 0 ){
+            if( !parseOptLevel(arg + 2, options) ){
+                std::cerr << "Unknown optimization level: " << arg << std::endl;
+                return false;
+            }
+        }else if( strcmp(arg, "-o") == 0 ){
+            if( i + 1 >= argc ){
+                std::cerr << "-o needs a file name" << std::endl;
+                return false;
+            }
+            options.output = argv[++i];
+        }else if( strcmp(arg, "-S") == 0 ){
+            options.emit = OutputKind::Assembly;
+        }else if( strcmp(arg, "-emit-llvm") == 0 ){
+            options.emit = OutputKind::LLVMIR;
+        }else if( strcmp(arg, "-emit-bc") == 0 ){
+            options.emit = OutputKind::Bitcode;
+        }else if( strcmp(arg, "-emit-ast") == 0 ){
+            options.emit = OutputKind::AST;
+        }else if( strcmp(arg, "-fdiscard-value-names") == 0 ){
+            options.discardValueNames = true;
+        }else if( strcmp(arg, "-fno-discard-value-names") == 0 ){
+            options.discardValueNames = false;
+        }else if( strcmp(arg, "-fno-ast-passes") == 0 ){
+            options.astPasses = false;
+        }else if( strcmp(arg, "-fno-ssa-locals") == 0 ){
+            options.ssaLocals = false;
+        }else if( strcmp(arg, "-ftime-report") == 0 ){
+            options.timeReport = true;
+        }else if( strcmp(arg, "-fmem-report") == 0 ){
+            options.memReport = true;
+        }else if( strcmp(arg, "-Rloop-hints") == 0 ){
+            options.loopHintReport = true;
+        }else if( const char* value = optionValue(arg, "-ftime-trace") ){
+            options.timeTrace = value;
+        }else if( const char* value = optionValue(arg, "-lexer") ){
+            if( strcmp(value, "flex") == 0 ){
+                options.lexer = LexerKind::Flex;
+            }else if( strcmp(value, "fast") == 0 ){
+                options.lexer = LexerKind::Fast;
+            }else{
+                std::cerr << "Unknown lexer: " << value << std::endl;
+                return false;
+            }
+        }else if( strcmp(arg, "-dump-tokens") == 0 ){
+            options.dumpTokens = true;
+        }else if( strcmp(arg, "-lex-only") == 0 ){
+            options.lexOnly = true;
+        }else if( strcmp(arg, "-ast-dump") == 0 ){
+            options.astDump = ASTDumpFormat::Text;
+        }else if( const char* value = optionValue(arg, "-ast-dump") ){
+            if( strcmp(value, "text") == 0 ){
+                options.astDump = ASTDumpFormat::Text;
+            }else if( strcmp(value, "json") == 0 ){
+                options.astDump = ASTDumpFormat::Json;
+            }else{
+                std::cerr << "Unknown AST dump format: " << value << std::endl;
+                return false;
+            }
+        }else if( const char* value = optionValue(arg, "-march") ){
+            options.cpu = value;
+        }else if( const char* value = optionValue(arg, "-mcpu") ){
+            options.cpu = value;
+        }else if( const char* value = optionValue(arg, "-mattr") ){
+            options.features = value;
+        }else if( const char* value = optionValue(arg, "-relocation-model") ){
+            if( !oneOf(value, {"static", "pic", "dynamic-no-pic"}) ){
+                std::cerr << "Unknown relocation model: " << value << std::endl;
+                return false;
+            }
+            options.relocModel = value;
+        }else if( const char* value = optionValue(arg, "-mcmodel") ){
+            if( !oneOf(value, {"small", "kernel", "medium", "large"}) ){
+                std::cerr << "Unknown code model: " << value << std::endl;
+                return false;
+            }
+            options.codeModel = value;
+        }else if( strncmp(arg, "-j", 2) == 0 ){
+            const char* value = arg[2] ? arg + 2 : (i + 1 < argc ? argv[++i] : "");
+            char* end;
+            long jobs = strtol(value, &end, 10);
+            if( *value == '\0' || *end != '\0' || jobs < 0 ){
+                std::cerr << "Bad job count: " << value << std::endl;
+                return false;
+            }
+            options.jobs = jobs;
+        }else if( const char* value = optionValue(arg, "--cache-dir") ){
+            options.cacheDir = value;
+        }else if( strcmp(arg, "--whole-program") == 0 ){
+            options.wholeProgram = true;
+        }else if( const char* value = optionValue(arg, "--export") ){
+            std::stringstream names(value);
+            std::string name;
+            while( std::getline(names, name, ',') ){
+                if( !name.empty() )
+                    options.exports.push_back(name);
+            }
+        }else if( strcmp(arg, "--jit") == 0 ){
+            options.jit = true;
+        }else if( strcmp(arg, "--daemon") == 0 ){
+            options.daemon = true;
+        }else if( const char* value = optionValue(arg, "--daemon") ){
+            options.daemon = true;
+            options.daemonSocket = value;
+        }else if( strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0 ){
+            printUsage(argv[0]);
+            exit(0);
+        }else if( arg[0] != '-' ){
+            options.inputs.push_back(arg);
+        }else{
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return false;
+        }
+    }
+    if( !options.output.empty() && options.inputs.size() > 1 && !options.wholeProgram ){
+        std::cerr << "-o cannot name the outputs of several input files" << std::endl;
+        return false;
+    }
+    if( options.emit == OutputKind::AST && (options.wholeProgram || options.jit || options.daemon) ){
+        std::cerr << "-emit-ast only parses, it cannot be combined with --whole-program, --jit or --daemon" << std::endl;
+        return false;
+    }
+    //the cached functions only reach the output file of a plain compile,
+    //never the JIT, the whole-program link or the daemon
+    if( !options.cacheDir.empty() && (options.jit || options.wholeProgram || options.daemon) ){
+        std::cerr << "--cache-dir cannot be combined with --jit, --whole-program or --daemon" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static const char* outputExtension(OutputKind kind){
+    switch (kind){
+        case OutputKind::Assembly:
+            return ".s";
+        case OutputKind::LLVMIR:
+            return ".ll";
+        case OutputKind::Bitcode:
+            return ".bc";
+        case OutputKind::AST:
+            return ".ast";
+        default:
+            return ".o";
+    }
+}
+
+std::string outputFileFor(const std::string& input, const CompilerOptions& options){
+    if( !options.output.empty() )
+        return options.output;
+    if( input.empty() )
+        return std::string("output") + outputExtension(options.emit);
+
+    //replace the extension of the file name, not a dot in a directory name
+    size_t slash = input.find_last_of('/');
+    size_t dot = input.find_last_of('.');
+    std::string stem = input;
+    if( dot != std::string::npos && (slash == std::string::npos || dot > slash) )
+        stem = input.substr(0, dot);
+    return stem + outputExtension(options.emit);
+}
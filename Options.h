@@ -0,0 +1,112 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <string>
+#include <vector>
+
+//What the compiler writes out
+enum class OutputKind{
+    Object,     //default, native object file
+    Assembly,   //-S, native assembly
+    LLVMIR,     //-emit-llvm, textual LLVM IR
+    Bitcode,    //-emit-bc, LLVM bitcode
+    AST,        //-emit-ast, the parsed program in the binary AST format (ASTFile.h)
+};
+
+//Which scanner feeds grammar.y, both produce the same token stream
+enum class LexerKind{
+    Flex,       //token.l
+    Fast,       //FastLexer, classifies 16/32 bytes at a time
+};
+
+//-ast-dump prints the tree of every input instead of compiling it
+enum class ASTDumpFormat{
+    None,
+    Text,       //-ast-dump, one indented line per node
+    Json,       //-ast-dump=json, nested {"name", "children"} objects
+};
+
+//The switches of one compiler invocation, filled by parseOptions from argv
+struct CompilerOptions{
+    //-O0/-O1/-O2/-O3 select the middle-end pipeline, -Os/-Oz also set the size level
+    unsigned optLevel = 0;
+    unsigned sizeLevel = 0;
+
+    //-mcpu=<cpu> or -march=<cpu>, "native" asks LLVM for the host cpu and its features
+    std::string cpu;
+    //-mattr=+avx2,-fma style feature list, applied after the native features
+    std::string features;
+    //-relocation-model=static|pic|dynamic-no-pic, empty keeps the target default
+    std::string relocModel;
+    //-mcmodel=small|kernel|medium|large, empty keeps the target default
+    std::string codeModel;
+
+    OutputKind emit = OutputKind::Object;
+    //-o <file>, by default output.<ext> for stdin and <input>.<ext> for input files
+    std::string output;
+
+    //Drop the names of IR values ("calltmp", "cast", ...) instead of uniquing them.
+    //On by default in release (NDEBUG) builds, -f[no-]discard-value-names overrides.
+#ifdef NDEBUG
+    bool discardValueNames = true;
+#else
+    bool discardValueNames = false;
+#endif
+
+    //-lexer=flex|fast, a build with -DFAST_LEXER defaults to the fast one
+#ifdef FAST_LEXER
+    LexerKind lexer = LexerKind::Fast;
+#else
+    LexerKind lexer = LexerKind::Flex;
+#endif
+    //-dump-tokens prints the token stream of every input and stops,
+    //-lex-only only runs the scanner over them, to time it
+    bool dumpTokens = false;
+    bool lexOnly = false;
+    ASTDumpFormat astDump = ASTDumpFormat::None;
+    //-fno-ast-passes hands the tree to codegen as parsed (ASTPass.h)
+    bool astPasses = true;
+    //-fno-ssa-locals keeps every local in an alloca instead of building SSA
+    //for the scalars in codegen (SSABuilder.h)
+    bool ssaLocals = true;
+
+    //--jit runs main in process through ORC instead of writing output.o
+    bool jit = false;
+
+    //Source files to compile, stdin when empty
+    std::vector<std::string> inputs;
+    //-j <n> worker threads for multiple inputs, 0 picks the number of cores
+    unsigned jobs = 0;
+
+    //--cache-dir=<dir> keeps the optimized bitcode of every function there and
+    //regenerates only the functions that changed
+    std::string cacheDir;
+
+    //--whole-program links all inputs and optimizes them as one module,
+    //--export=<a,b> keeps symbols other than main visible in the result
+    bool wholeProgram = false;
+    std::vector<std::string> exports;
+
+    //--daemon serves compile requests on stdin/stdout, --daemon=<path> on a Unix socket
+    bool daemon = false;
+    std::string daemonSocket;
+
+    //-ftime-report/-fmem-report print a per-phase table to stderr at exit,
+    //-ftime-trace=<file> writes the phases and functions as Chrome trace events
+    bool timeReport = false;
+    bool memReport = false;
+    std::string timeTrace;
+    //-Rloop-hints prints the @hints of every annotated loop and what the loop
+    //vectorizer and unroller made of them
+    bool loopHintReport = false;
+};
+
+//Return false on an unknown or malformed switch, the reason is written to stderr
+bool parseOptions(int argc, char** argv, CompilerOptions& options);
+
+void printUsage(const char* program);
+
+//The file the result for input goes to, input is empty for stdin
+std::string outputFileFor(const std::string& input, const CompilerOptions& options);
+
+#endif //OPTIONS_H
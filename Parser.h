@@ -0,0 +1,32 @@
+#ifndef PARSER_H
+#define PARSER_H
+
+#include <stddef.h>
+#include <memory>
+#include "ASTNodes.h"
+#include "Options.h"
+#include "SourceBuffer.h"
+
+class FastLexer;
+
+//Everything one parse works on. The bison parser is pure and the flex
+//scanner reentrant, so parses on different threads share nothing.
+struct ParseState{
+    //the flex yyscan_t, or the fast lexer when that one feeds the parser
+    void* scanner = nullptr;
+    FastLexer* fastLexer = nullptr;
+    //where the nodes go, the start rule sets its root
+    ASTArena* arena = nullptr;
+};
+
+//Run the flex/bison front end over a source buffer, in place.
+//Returns the arena holding the AST, its root in arena->root, or nullptr when
+//the source has a syntax error. The literals of the AST point into source,
+//it has to outlive the arena. Safe to call from several threads at once.
+std::unique_ptr<ASTArena> parseBuffer(SourceBuffer& source, LexerKind lexer);
+
+//Run only the scanner over source and return the number of tokens; with dump
+//every token is printed to stdout with its text and value (-dump-tokens)
+size_t scanTokens(SourceBuffer& source, LexerKind lexer, bool dump);
+
+#endif //PARSER_H
@@ -0,0 +1,241 @@
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Format.h>
+
+#include <sys/resource.h>
+#include <time.h>
+#include <stdlib.h>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include "Profile.h"
+
+using namespace llvm;
+using std::string;
+using Clock = std::chrono::steady_clock;
+
+std::atomic<uint64_t> nodeCounts[(size_t)NodeKind::Count];
+std::atomic<uint64_t> astArenaBytes(0);
+bool countNodes = false;
+
+//Only counted while profiling, so a normal build pays one predictable branch per new
+static bool countAllocations = false;
+static std::atomic<uint64_t> allocations(0);
+static std::atomic<uint64_t> allocatedBytes(0);
+
+void* operator new(size_t size){
+    if( countAllocations ){
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    }
+    if( size == 0 )
+        size = 1;
+    while( true ){
+        if( void* memory = malloc(size) )
+            return memory;
+        std::new_handler handler = std::get_new_handler();
+        if( !handler )
+            throw std::bad_alloc();
+        handler();
+    }
+}
+
+void operator delete(void* memory) noexcept{
+    free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept{
+    free(memory);
+}
+
+struct PhaseTotals{
+    uint64_t count = 0;
+    double wallMs = 0;
+    double cpuMs = 0;
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+    long peakRssKB = 0;
+};
+
+struct TraceEvent{
+    string name;
+    const char* phase;
+    double startUs;
+    double durationUs;
+    unsigned thread;
+};
+
+static bool profiling = false;
+static bool tracing = false;
+static Clock::time_point profileStart;
+static std::mutex profileMutex;
+//phase name -> totals, in the order the phases first finished
+static std::vector<std::pair<string, PhaseTotals>> phases;
+static std::vector<TraceEvent> traceEvents;
+
+static double cpuNowMs(){
+    timespec now;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1e6;
+}
+
+static long peakRssKB(){
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    //bytes on macOS, KB on Linux
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+static unsigned threadNumber(){
+    static std::atomic<unsigned> nextThread(0);
+    thread_local unsigned number = nextThread++;
+    return number;
+}
+
+void enableProfiling(bool trace){
+    profiling = true;
+    tracing = tracing || trace;
+    countAllocations = true;
+    countNodes = true;
+    profileStart = Clock::now();
+}
+
+bool profilingEnabled(){
+    return profiling;
+}
+
+PhaseTimer::PhaseTimer(const char* phase, StringRef detail){
+    if( !profiling )
+        return;
+    //spans of single functions only matter to the trace
+    if( !detail.empty() && !tracing )
+        return;
+    this->phase = phase;
+    this->detail = detail.str();
+    allocationsStart = allocations.load(std::memory_order_relaxed);
+    bytesStart = allocatedBytes.load(std::memory_order_relaxed);
+    cpuStart = cpuNowMs();
+    wallStart = Clock::now();
+}
+
+PhaseTimer::~PhaseTimer(){
+    if( !phase )
+        return;
+    auto wallEnd = Clock::now();
+    double cpuMs = cpuNowMs() - cpuStart;
+    double wallMs = std::chrono::duration<double, std::milli>(wallEnd - wallStart).count();
+
+    std::lock_guard<std::mutex> lock(profileMutex);
+    if( detail.empty() ){
+        auto it = phases.begin();
+        while( it != phases.end() && it->first != phase )
+            ++it;
+        if( it == phases.end() )
+            it = phases.insert(phases.end(), std::make_pair(string(phase), PhaseTotals()));
+        PhaseTotals& totals = it->second;
+        totals.count++;
+        totals.wallMs += wallMs;
+        totals.cpuMs += cpuMs;
+        totals.allocations += allocations.load(std::memory_order_relaxed) - allocationsStart;
+        totals.bytes += allocatedBytes.load(std::memory_order_relaxed) - bytesStart;
+        totals.peakRssKB = std::max(totals.peakRssKB, peakRssKB());
+    }
+    if( tracing ){
+        double startUs = std::chrono::duration<double, std::micro>(wallStart - profileStart).count();
+        traceEvents.push_back(TraceEvent{detail.empty() ? string(phase) : detail, phase,
+                                         startUs, wallMs * 1000.0, threadNumber()});
+    }
+}
+
+void printProfileReport(raw_ostream& out, bool timeReport, bool memReport){
+    std::lock_guard<std::mutex> lock(profileMutex);
+
+    out << "===----------------------------------------------------------------------===\n"
+        << "                        SubC compiler phase report\n"
+        << "===----------------------------------------------------------------------===\n";
+    out << left_justify("phase", 12) << right_justify("runs", 7);
+    if( timeReport )
+        out << right_justify("wall (ms)", 13) << right_justify("cpu (ms)", 13);
+    if( memReport )
+        out << right_justify("allocations", 13) << right_justify("alloc (KB)", 13) << right_justify("peak RSS (KB)", 15);
+    out << "\n";
+
+    PhaseTotals sum;
+    for(auto& entry: phases){
+        const PhaseTotals& totals = entry.second;
+        out << left_justify(entry.first, 12) << format(" %6llu", (unsigned long long)totals.count);
+        if( timeReport )
+            out << format(" %12.3f %12.3f", totals.wallMs, totals.cpuMs);
+        if( memReport )
+            out << format(" %12llu %12llu %14ld", (unsigned long long)totals.allocations,
+                          (unsigned long long)(totals.bytes / 1024), totals.peakRssKB);
+        out << "\n";
+        sum.wallMs += totals.wallMs;
+        sum.cpuMs += totals.cpuMs;
+        sum.allocations += totals.allocations;
+        sum.bytes += totals.bytes;
+    }
+    out << left_justify("total", 12) << right_justify("", 7);
+    if( timeReport )
+        out << format(" %12.3f %12.3f", sum.wallMs, sum.cpuMs);
+    if( memReport )
+        out << format(" %12llu %12llu %14ld", (unsigned long long)sum.allocations,
+                      (unsigned long long)(sum.bytes / 1024), peakRssKB());
+    out << "\n";
+
+    if( memReport ){
+        out << "\nAST nodes\n";
+        uint64_t total = 0;
+        for(size_t index=0; index<(size_t)NodeKind::Count; index++){
+            uint64_t count = nodeCounts[index].load(std::memory_order_relaxed);
+            if( count == 0 )
+                continue;
+            out << "  " << left_justify(nodeKindName((NodeKind)index), 22) << format(" %10llu\n", (unsigned long long)count);
+            total += count;
+        }
+        out << "  " << left_justify("total", 22) << format(" %10llu\n", (unsigned long long)total);
+        out << "  " << left_justify("arena KB", 22) << format(" %10llu\n", (unsigned long long)(astArenaBytes.load() / 1024));
+    }
+    out.flush();
+}
+
+static void writeJsonString(raw_ostream& out, StringRef value){
+    out << '"';
+    for(char c: value){
+        if( c == '"' || c == '\\' )
+            out << '\\' << c;
+        else if( (unsigned char)c < 0x20 )
+            out << format("\\u%04x", c);
+        else
+            out << c;
+    }
+    out << '"';
+}
+
+bool writeTrace(const string& path){
+    std::error_code errorCode;
+    raw_fd_ostream out(path, errorCode, sys::fs::F_None);
+    if( errorCode ){
+        errs() << path << ": " << errorCode.message() << "\n";
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(profileMutex);
+    out << "{\"traceEvents\":[\n";
+    for(size_t index=0; index<traceEvents.size(); index++){
+        const TraceEvent& event = traceEvents[index];
+        out << "{\"name\":";
+        writeJsonString(out, event.name);
+        out << ",\"cat\":";
+        writeJsonString(out, event.phase);
+        out << format(",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                      event.thread, event.startUs, event.durationUs);
+        out << (index + 1 < traceEvents.size() ? ",\n" : "\n");
+    }
+    out << "],\"displayTimeUnit\":\"ms\"}\n";
+    return true;
+}
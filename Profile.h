@@ -0,0 +1,61 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <stdint.h>
+
+#include "ASTKind.h"
+
+extern std::atomic<uint64_t> nodeCounts[(size_t)NodeKind::Count];
+
+//Bytes of the AST arenas, they come from malloc and miss the new/delete count
+extern std::atomic<uint64_t> astArenaBytes;
+
+//Set by enableProfiling before the parse, so without a report every node pays
+//one predictable branch instead of an atomic add
+extern bool countNodes;
+
+inline void countNode(NodeKind kind){
+    if( countNodes )
+        nodeCounts[(size_t)kind].fetch_add(1, std::memory_order_relaxed);
+}
+
+//Turn on the collection of phase records; trace additionally keeps every span
+//(phases and single functions) for the Chrome trace written by writeTrace
+void enableProfiling(bool trace);
+bool profilingEnabled();
+
+//Time one phase of the compiler from construction to destruction. A timer with
+//an empty detail is a phase ("parse", "codegen", ...) and goes into the report
+//table; with a detail (a function name) it is a span of the trace only.
+//Does nothing unless profiling is enabled.
+class PhaseTimer{
+private:
+    const char* phase = nullptr;
+    std::string detail;
+    std::chrono::steady_clock::time_point wallStart;
+    double cpuStart = 0;
+    uint64_t allocationsStart = 0;
+    uint64_t bytesStart = 0;
+
+public:
+    explicit PhaseTimer(const char* phase, llvm::StringRef detail = "");
+    ~PhaseTimer();
+
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+};
+
+//-ftime-report prints wall and cpu time per phase, -fmem-report the allocations,
+//peak RSS, the AST node counts by class and the bytes of the AST arenas
+void printProfileReport(llvm::raw_ostream& out, bool timeReport, bool memReport);
+
+//Write every span as Chrome trace events (chrome://tracing, Perfetto)
+bool writeTrace(const std::string& path);
+
+#endif //PROFILE_H
@@ -0,0 +1,119 @@
+#include <llvm/IR/CFG.h>
+#include <llvm/IR/Constants.h>
+
+#include <assert.h>
+
+#include "SSABuilder.h"
+
+using namespace llvm;
+
+SSABuilder::Variable SSABuilder::newVariable(Type* type, StringRef name){
+    VariableInfo info;
+    info.type = type;
+    info.name = name.str();
+    variables.push_back(std::move(info));
+    return variables.size() - 1;
+}
+
+void SSABuilder::writeVariable(Variable variable, BasicBlock* block, Value* value){
+    variables[variable].definitions[block] = value;
+}
+
+Value* SSABuilder::readVariable(Variable variable, BasicBlock* block){
+    auto& definitions = variables[variable].definitions;
+    auto found = definitions.find(block);
+    if( found != definitions.end() )
+        return found->second;
+    return readVariableRecursive(variable, block);
+}
+
+PHINode* SSABuilder::createPhi(Variable variable, BasicBlock* block){
+    PHINode* phi = PHINode::Create(variables[variable].type, 2, variables[variable].name);
+    if( block->empty() )
+        block->getInstList().push_back(phi);
+    else
+        phi->insertBefore(&block->front());
+    return phi;
+}
+
+Value* SSABuilder::readVariableRecursive(Variable variable, BasicBlock* block){
+    Value* value;
+    if( !sealedBlocks.count(block) ){
+        //not every predecessor is known yet, sealBlock fills in the operands
+        PHINode* phi = createPhi(variable, block);
+        incompletePhis[block].push_back(std::make_pair(variable, phi));
+        value = phi;
+    }else if( BasicBlock* predecessor = block->getSinglePredecessor() ){
+        value = readVariable(variable, predecessor);
+    }else if( pred_begin(block) == pred_end(block) ){
+        //read before any write, like a load of a fresh alloca
+        value = UndefValue::get(variables[variable].type);
+    }else{
+        //the phi is the definition while the operands are read, which ends
+        //the recursion around loops
+        PHINode* phi = createPhi(variable, block);
+        writeVariable(variable, block, phi);
+        value = addPhiOperands(variable, phi);
+    }
+    writeVariable(variable, block, value);
+    return value;
+}
+
+Value* SSABuilder::addPhiOperands(Variable variable, PHINode* phi){
+    //all operands are read before the first is added: reading one may remove
+    //a trivial phi that an earlier one was, the handles follow that
+    SmallVector<std::pair<BasicBlock*, WeakTrackingVH>, 4> incoming;
+    for(BasicBlock* predecessor: predecessors(phi->getParent())){
+        incoming.push_back(std::make_pair(predecessor, WeakTrackingVH(readVariable(variable, predecessor))));
+    }
+    for(auto& edge: incoming){
+        phi->addIncoming(edge.second, edge.first);
+    }
+    return tryRemoveTrivialPhi(phi);
+}
+
+Value* SSABuilder::tryRemoveTrivialPhi(PHINode* phi){
+    Value* same = nullptr;
+    for(Value* operand: phi->incoming_values()){
+        if( operand == same || operand == phi )
+            continue;
+        if( same )
+            return phi;
+        same = operand;
+    }
+    if( same == nullptr )
+        same = UndefValue::get(phi->getType());
+
+    //the phis that used this one may have become trivial in turn
+    SmallVector<WeakVH, 8> users;
+    for(User* user: phi->users()){
+        if( user != phi && isa<PHINode>(user) )
+            users.push_back(WeakVH(user));
+    }
+    phi->replaceAllUsesWith(same);
+    phi->eraseFromParent();
+    for(auto& user: users){
+        if( auto userPhi = dyn_cast_or_null<PHINode>((Value*)user) )
+            tryRemoveTrivialPhi(userPhi);
+    }
+    return same;
+}
+
+void SSABuilder::sealBlock(BasicBlock* block){
+    auto found = incompletePhis.find(block);
+    if( found != incompletePhis.end() ){
+        auto phis = std::move(found->second);
+        incompletePhis.erase(found);
+        for(auto& incomplete: phis){
+            addPhiOperands(incomplete.first, incomplete.second);
+        }
+    }
+    sealedBlocks.insert(block);
+}
+
+void SSABuilder::clear(){
+    assert(incompletePhis.empty() && "a block was left unsealed");
+    variables.clear();
+    incompletePhis.clear();
+    sealedBlocks.clear();
+}
@@ -0,0 +1,57 @@
+#ifndef SSABUILDER_H
+#define SSABUILDER_H
+
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/SmallPtrSet.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/ValueHandle.h>
+
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+//SSA form for the scalar locals of one function, built while the function is
+//generated (Braun et al., Simple and Efficient Construction of Static Single
+//Assignment Form, CC 2013). Codegen writes a variable where it assigns it and
+//reads it where it uses it; phis are only made where two definitions meet and
+//trivial ones are removed again. A block is sealed once every branch to it
+//exists, reads in a block that is not sealed yet get a phi that is
+//completed by sealBlock.
+class SSABuilder{
+public:
+    typedef int32_t Variable;
+
+    Variable newVariable(llvm::Type* type, llvm::StringRef name);
+
+    void writeVariable(Variable variable, llvm::BasicBlock* block, llvm::Value* value);
+    llvm::Value* readVariable(Variable variable, llvm::BasicBlock* block);
+
+    void sealBlock(llvm::BasicBlock* block);
+
+    //Forget the variables and blocks of the last function
+    void clear();
+
+private:
+    struct VariableInfo{
+        llvm::Type* type;
+        std::string name;
+        //the value of the variable at the end of each block that defines it,
+        //handles follow the replacement of a trivial phi
+        llvm::DenseMap<llvm::BasicBlock*, llvm::WeakTrackingVH> definitions;
+    };
+
+    std::vector<VariableInfo> variables;
+    llvm::DenseMap<llvm::BasicBlock*, llvm::SmallVector<std::pair<Variable, llvm::PHINode*>, 4>> incompletePhis;
+    llvm::SmallPtrSet<llvm::BasicBlock*, 32> sealedBlocks;
+
+    llvm::PHINode* createPhi(Variable variable, llvm::BasicBlock* block);
+    llvm::Value* readVariableRecursive(Variable variable, llvm::BasicBlock* block);
+    llvm::Value* addPhiOperands(Variable variable, llvm::PHINode* phi);
+    llvm::Value* tryRemoveTrivialPhi(llvm::PHINode* phi);
+};
+
+#endif //SSABUILDER_H
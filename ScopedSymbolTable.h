@@ -0,0 +1,104 @@
+#ifndef SCOPEDSYMBOLTABLE_H
+#define SCOPEDSYMBOLTABLE_H
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/IR/Value.h>
+
+#include <assert.h>
+#include <stdint.h>
+#include <ostream>
+#include <vector>
+
+#include "Symbol.h"
+
+class NIdentifier;
+
+//What codegen knows about one declaration of a name
+struct SymbolInfo{
+    llvm::Value* value = nullptr;
+    NIdentifier* type = nullptr;
+    bool isFuncArg = false;
+    //the SSABuilder variable of a scalar local, -1 when it lives in value
+    int32_t ssaVariable = -1;
+    //the dimensions of an array, outermost first; kept by the caller
+    llvm::ArrayRef<uint64_t> arraySize;
+};
+
+//The names visible while generating code, one SymbolInfo per declaration.
+//The entries of the open scopes are kept in declaration order; this log is
+//also the undo log. Each entry remembers the entry it shadows, so a lookup
+//is one probe by Symbol::id() and leaving a scope only touches the entries
+//of that scope. The map only holds the names of the open scopes, not every
+//name the process has interned.
+class ScopedSymbolTable{
+private:
+    struct Entry{
+        SymbolInfo info;
+        Symbol name;
+        //1 + the index of the entry this one shadows, 0 for none
+        uint32_t shadowed;
+    };
+
+    std::vector<Entry> entries;
+    //Symbol::id() -> 1 + the index of the innermost entry
+    llvm::DenseMap<uint32_t, uint32_t> innermost;
+    //the size of entries when each open scope was entered
+    std::vector<size_t> scopeStarts;
+
+public:
+    void enterScope(){
+        scopeStarts.push_back(entries.size());
+    }
+
+    void leaveScope(){
+        size_t start = scopeStarts.back();
+        scopeStarts.pop_back();
+        while( entries.size() > start ){
+            const Entry& entry = entries.back();
+            if( entry.shadowed != 0 )
+                innermost[entry.name.id()] = entry.shadowed;
+            else
+                innermost.erase(entry.name.id());
+            entries.pop_back();
+        }
+    }
+
+    //nullptr for an undeclared name. The pointer is good until the next declare.
+    const SymbolInfo* lookup(Symbol name) const{
+        auto found = innermost.find(name.id());
+        if( found == innermost.end() )
+            return nullptr;
+        return &entries[found->second - 1].info;
+    }
+
+    //The entry of name in the innermost scope, added when the scope has none
+    //yet; a second declaration in the same scope updates the first one
+    SymbolInfo& declare(Symbol name){
+        assert(!scopeStarts.empty() && "declaration outside of any scope");
+        //0 when the name is not visible yet
+        uint32_t& current = innermost[name.id()];
+        if( current != 0 && current - 1 >= scopeStarts.back() )
+            return entries[current - 1].info;
+        Entry entry;
+        entry.name = name;
+        entry.shadowed = current;
+        entries.push_back(entry);
+        current = entries.size();
+        return entries.back().info;
+    }
+
+    //Every entry of the open scopes, indented one tab per scope
+    void print(std::ostream& out) const{
+        size_t scope = 0;
+        for(size_t i=0; i<entries.size(); i++){
+            while( scope < scopeStarts.size() && scopeStarts[scope] <= i )
+                scope++;
+            for(size_t tab=1; tab<scope; tab++)
+                out << '\t';
+            out << entries[i].name << " = " << entries[i].info.value << ": " << entries[i].info.type << std::endl;
+        }
+    }
+};
+
+#endif //SCOPEDSYMBOLTABLE_H
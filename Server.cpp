@@ -0,0 +1,301 @@
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <chrono>
+#include <string>
+
+#include "ASTPass.h"
+#include "CodeGen.h"
+#include "ObjGen.h"
+#include "Parser.h"
+#include "Profile.h"
+#include "Server.h"
+#include "Symbol.h"
+
+using namespace llvm;
+using Clock = std::chrono::steady_clock;
+
+//The largest payload a client may announce, the length comes from the
+//header as is and a bogus one must not take the server's memory
+static const size_t maxRequestBytes = 64 << 20;
+
+//Buffered reading of header lines and payloads from one client
+class FrameReader{
+private:
+    int fd;
+    char buffer[1 << 16];
+    size_t begin = 0;
+    size_t end = 0;
+
+    bool fill(){
+        begin = 0;
+        ssize_t count;
+        do{
+            count = read(fd, buffer, sizeof(buffer));
+        }while( count < 0 && errno == EINTR );
+        end = count > 0 ? count : 0;
+        return count > 0;
+    }
+
+public:
+    explicit FrameReader(int fd): fd(fd){}
+
+    bool readLine(string& line){
+        line.clear();
+        while( true ){
+            if( begin == end && !fill() )
+                return !line.empty();
+            char* newline = (char*)memchr(buffer + begin, '\n', end - begin);
+            if( newline ){
+                line.append(buffer + begin, newline - (buffer + begin));
+                begin = newline - buffer + 1;
+                return true;
+            }
+            line.append(buffer + begin, end - begin);
+            begin = end;
+        }
+    }
+
+    bool readBytes(string& data, size_t length){
+        data.clear();
+        data.reserve(length);
+        while( data.size() < length ){
+            if( begin == end && !fill() )
+                return false;
+            size_t count = std::min(length - data.size(), end - begin);
+            data.append(buffer + begin, count);
+            begin += count;
+        }
+        return true;
+    }
+};
+
+static bool writeAll(int fd, const char* data, size_t length){
+    while( length > 0 ){
+        ssize_t count = write(fd, data, length);
+        if( count < 0 ){
+            if( errno == EINTR )
+                continue;
+            return false;
+        }
+        data += count;
+        length -= count;
+    }
+    return true;
+}
+
+static bool reply(int fd, bool ok, const string& payload){
+    string header = (ok ? "ok " : "error ") + std::to_string(payload.size()) + "\n";
+    return writeAll(fd, header.data(), header.size()) && writeAll(fd, payload.data(), payload.size());
+}
+
+class CompileServer{
+private:
+    const CompilerOptions& options;
+    TargetMachine* targetMachine;
+
+    //counters reported by the stats request
+    uint64_t requests = 0;
+    uint64_t failures = 0;
+    uint64_t bytesIn = 0;
+    uint64_t bytesOut = 0;
+    double busyMs = 0;
+    double maxMs = 0;
+    Clock::time_point started = Clock::now();
+
+    bool compile(const string& source, const string& mode, string& result){
+        //replaces the copy flex made of the request, it scans this one in place;
+        //the literals of the AST point into it
+        std::unique_ptr<SourceBuffer> buffer = SourceBuffer::fromBytes(source.data(), source.size());
+        std::unique_ptr<ASTArena> tree;
+        {
+            PhaseTimer timer("parse");
+            tree = parseBuffer(*buffer, options.lexer);
+        }
+        if( !tree ){
+            result = "syntax error";
+            return false;
+        }
+        runASTPasses(*tree, options);
+
+        CodeGenContext context;
+        context.llvmContext.setDiscardValueNames(options.discardValueNames);
+        context.ssaLocals = options.ssaLocals;
+        {
+            PhaseTimer timer("codegen");
+            context.generateCode(*tree->root);
+        }
+
+        raw_string_ostream resultStream(result);
+        if( !prepareModule(*context.theModule, targetMachine, options, resultStream) ){
+            resultStream.flush();
+            return false;
+        }
+
+        if( mode == "ir" ){
+            context.theModule->print(resultStream, nullptr);
+            resultStream.flush();
+            return true;
+        }
+
+        SmallVector<char, 0> object;
+        raw_svector_ostream objectStream(object);
+        if( !emitOutput(*context.theModule, targetMachine, OutputKind::Object, objectStream) ){
+            result = "object emission failed";
+            return false;
+        }
+        result.assign(object.begin(), object.end());
+        return true;
+    }
+
+    string statsReport() const{
+        double uptime = std::chrono::duration<double>(Clock::now() - started).count();
+        double busy = busyMs / 1000.0;
+        string report;
+        raw_string_ostream out(report);
+        out << "requests " << requests << "\n"
+            << "failures " << failures << "\n"
+            << "bytes_in " << bytesIn << "\n"
+            << "bytes_out " << bytesOut << "\n"
+            << "latency_avg_ms " << (requests ? busyMs / requests : 0.0) << "\n"
+            << "latency_max_ms " << maxMs << "\n"
+            << "busy_s " << busy << "\n"
+            << "uptime_s " << uptime << "\n"
+            << "requests_per_busy_s " << (busy > 0 ? requests / busy : 0.0) << "\n"
+            << "source_bytes_per_busy_s " << (busy > 0 ? bytesIn / busy : 0.0) << "\n";
+        out.flush();
+        return report;
+    }
+
+public:
+    CompileServer(const CompilerOptions& options, TargetMachine* targetMachine)
+            : options(options), targetMachine(targetMachine){
+    }
+
+    //Serve one client, returns false once a quit request was seen
+    bool serve(int inFd, int outFd){
+        FrameReader reader(inFd);
+        string line, source, result;
+
+        while( reader.readLine(line) ){
+            if( line == "quit" ){
+                reply(outFd, true, "");
+                return false;
+            }
+            if( line == "stats" ){
+                if( !reply(outFd, true, statsReport()) )
+                    return true;
+                continue;
+            }
+
+            char mode[8];
+            size_t length;
+            if( sscanf(line.c_str(), "compile %7s %zu", mode, &length) != 2 ||
+                (strcmp(mode, "obj") != 0 && strcmp(mode, "ir") != 0) ){
+                if( !reply(outFd, false, "bad request: " + line) )
+                    return true;
+                continue;
+            }
+            if( length > maxRequestBytes ){
+                //the payload is not read, the stream cannot be resynchronized
+                reply(outFd, false, "request too large: " + std::to_string(length) + " bytes, at most " + std::to_string(maxRequestBytes));
+                return true;
+            }
+            if( !reader.readBytes(source, length) )
+                return true;
+
+            auto start = Clock::now();
+            result.clear();
+            bool ok = compile(source, mode, result);
+            //the tree and the module are gone, so are the names of this request
+            resetSymbols();
+            double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+            requests++;
+            failures += ok ? 0 : 1;
+            bytesIn += length;
+            bytesOut += ok ? result.size() : 0;
+            busyMs += ms;
+            maxMs = std::max(maxMs, ms);
+
+            if( !reply(outFd, ok, result) )
+                return true;
+        }
+        return true;
+    }
+};
+
+static int serveStdio(CompileServer& server){
+    //Reply on a private copy of stdout and send everything else that writes to
+    //stdout (IR dumps, debug prints) to stderr, so it cannot corrupt the framing
+    int replyFd = dup(STDOUT_FILENO);
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+    server.serve(STDIN_FILENO, replyFd);
+    close(replyFd);
+    return 0;
+}
+
+static int serveSocket(CompileServer& server, const string& path){
+    int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if( listenFd < 0 ){
+        perror("socket");
+        return 1;
+    }
+
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if( path.size() >= sizeof(address.sun_path) ){
+        errs() << "Socket path too long: " << path << "\n";
+        close(listenFd);
+        return 1;
+    }
+    strcpy(address.sun_path, path.c_str());
+    unlink(path.c_str());
+
+    if( bind(listenFd, (sockaddr*)&address, sizeof(address)) < 0 || listen(listenFd, 16) < 0 ){
+        perror(path.c_str());
+        close(listenFd);
+        return 1;
+    }
+
+    bool running = true;
+    while( running ){
+        int clientFd = accept(listenFd, nullptr, nullptr);
+        if( clientFd < 0 ){
+            if( errno == EINTR )
+                continue;
+            perror("accept");
+            break;
+        }
+        running = server.serve(clientFd, clientFd);
+        close(clientFd);
+    }
+
+    close(listenFd);
+    unlink(path.c_str());
+    return 0;
+}
+
+int runCompileServer(const CompilerOptions& options){
+    //a client hanging up mid reply must not kill the server
+    signal(SIGPIPE, SIG_IGN);
+
+    doInit();
+    std::unique_ptr<TargetMachine> targetMachine(createTargetMachine(options));
+    if( !targetMachine ){
+        return 1;
+    }
+
+    CompileServer server(options, targetMachine.get());
+    if( options.daemonSocket.empty() )
+        return serveStdio(server);
+    return serveSocket(server, options.daemonSocket);
+}
@@ -0,0 +1,20 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "Options.h"
+
+//Keep LLVM initialized and one TargetMachine cached, and compile the source
+//buffers sent by clients until one of them asks to quit.
+//
+//Requests and replies are framed as a header line and a payload:
+//  compile obj <n>\n<n bytes of source>    -> ok <n>\n<object file bytes>
+//  compile ir <n>\n<n bytes of source>     -> ok <n>\n<optimized LLVM IR text>
+//  stats\n                                 -> ok <n>\n<counter lines>
+//  quit\n                                  -> ok 0\n
+//A failed request is answered with error <n>\n<message>.
+//
+//With an empty options.daemonSocket the protocol runs over stdin/stdout,
+//otherwise the server listens on that Unix socket path.
+int runCompileServer(const CompilerOptions& options);
+
+#endif //SERVER_H
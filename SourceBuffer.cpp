@@ -0,0 +1,113 @@
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <new>
+
+#include "Profile.h"
+#include "SourceBuffer.h"
+
+//flex's YY_END_OF_BUFFER_CHAR, twice
+static const size_t terminators = 2;
+
+SourceBuffer::~SourceBuffer(){
+    if( mappedLength )
+        munmap(base, mappedLength);
+    else
+        free(base);
+}
+
+//Read everything left on fd into a heap block, growing it when the size was not known
+bool SourceBuffer::readFrom(int fd, size_t sizeHint){
+    //one byte over the hint so the read that sees the end does not grow the block
+    size_t capacity = sizeHint ? sizeHint + 1 : 64 * 1024;
+    base = (char*)malloc(capacity + terminators);
+    length = 0;
+    while( base ){
+        if( length == capacity ){
+            capacity *= 2;
+            char* grown = (char*)realloc(base, capacity + terminators);
+            if( !grown )
+                break;
+            base = grown;
+        }
+        ssize_t count = read(fd, base + length, capacity - length);
+        if( count < 0 && errno == EINTR )
+            continue;
+        if( count < 0 )
+            return false;
+        if( count == 0 ){
+            memset(base + length, 0, terminators);
+            return true;
+        }
+        length += count;
+    }
+    errno = ENOMEM;
+    return false;
+}
+
+//Map fd when it is a regular file, read it otherwise
+bool SourceBuffer::load(int fd){
+    struct stat status;
+    if( fstat(fd, &status) == 0 && S_ISREG(status.st_mode) ){
+        size_t size = status.st_size;
+        size_t page = sysconf(_SC_PAGESIZE);
+        size_t tail = size % page;
+        //past the end of the file the last page reads as zeros, there are the
+        //terminators as long as they fit in it; a mapping that runs into the
+        //next page would fault there
+        void* mapping = MAP_FAILED;
+        if( tail != 0 && page - tail >= terminators )
+            mapping = mmap(nullptr, size + terminators, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if( mapping != MAP_FAILED ){
+            madvise(mapping, size + terminators, MADV_SEQUENTIAL);
+            base = (char*)mapping;
+            length = size;
+            mappedLength = size + terminators;
+            return true;
+        }
+        return readFrom(fd, size);
+    }
+    return readFrom(fd, 0);
+}
+
+std::unique_ptr<SourceBuffer> SourceBuffer::fromFile(const std::string& path, std::string& error){
+    PhaseTimer timer("read");
+    int fd = open(path.c_str(), O_RDONLY);
+    if( fd < 0 ){
+        error = strerror(errno);
+        return nullptr;
+    }
+    std::unique_ptr<SourceBuffer> buffer(new SourceBuffer());
+    bool ok = buffer->load(fd);
+    if( !ok )
+        error = strerror(errno);
+    close(fd);
+    if( !ok )
+        return nullptr;
+    return buffer;
+}
+
+std::unique_ptr<SourceBuffer> SourceBuffer::fromStdin(std::string& error){
+    PhaseTimer timer("read");
+    std::unique_ptr<SourceBuffer> buffer(new SourceBuffer());
+    if( !buffer->load(STDIN_FILENO) ){
+        error = strerror(errno);
+        return nullptr;
+    }
+    return buffer;
+}
+
+std::unique_ptr<SourceBuffer> SourceBuffer::fromBytes(const char* bytes, size_t size){
+    std::unique_ptr<SourceBuffer> buffer(new SourceBuffer());
+    buffer->base = (char*)malloc(size + terminators);
+    if( !buffer->base )
+        throw std::bad_alloc();
+    memcpy(buffer->base, bytes, size);
+    memset(buffer->base + size, 0, terminators);
+    buffer->length = size;
+    return buffer;
+}
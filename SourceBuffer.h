@@ -0,0 +1,55 @@
+#ifndef SOURCEBUFFER_H
+#define SOURCEBUFFER_H
+
+#include <stddef.h>
+#include <memory>
+#include <string>
+
+//The bytes of one program followed by the two NUL bytes flex wants after the
+//end, so the scanner runs over them in place (yy_scan_buffer) instead of over
+//a copy. Files are mapped with MAP_PRIVATE: the scanner briefly writes a NUL
+//after every token, which only turns the pages it touches into private copies.
+//String literals in the AST point into the buffer, it has to outlive the AST.
+class SourceBuffer{
+private:
+    char* base = nullptr;
+    size_t length = 0;
+    //the size of the mapping, 0 when base is a heap block
+    size_t mappedLength = 0;
+
+    SourceBuffer(){}
+
+    bool load(int fd);
+    bool readFrom(int fd, size_t sizeHint);
+
+public:
+    ~SourceBuffer();
+
+    SourceBuffer(const SourceBuffer&) = delete;
+    SourceBuffer& operator=(const SourceBuffer&) = delete;
+
+    //Map the file at path, or read it when it cannot be mapped with the
+    //terminators in its last page. Returns nullptr and sets error on failure.
+    static std::unique_ptr<SourceBuffer> fromFile(const std::string& path, std::string& error);
+
+    //Stdin is mapped as well when it is redirected from a regular file
+    static std::unique_ptr<SourceBuffer> fromStdin(std::string& error);
+
+    //One copy of bytes that arrived some other way, e.g. over the server socket
+    static std::unique_ptr<SourceBuffer> fromBytes(const char* bytes, size_t size);
+
+    char* data() const{
+        return base;
+    }
+
+    //without the terminators
+    size_t size() const{
+        return length;
+    }
+
+    bool isMapped() const{
+        return mappedLength != 0;
+    }
+};
+
+#endif //SOURCEBUFFER_H
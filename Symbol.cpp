@@ -0,0 +1,90 @@
+#include <llvm/Support/Allocator.h>
+
+#include <atomic>
+#include <mutex>
+
+#include "Symbol.h"
+
+using namespace llvm;
+
+//The keys are copied into the bump allocator of the map, one allocation
+//per distinct name instead of one std::string per token. The map is shared
+//by all threads behind a mutex; intern() only gets there for the names its
+//thread has not seen yet.
+class SymbolTable{
+private:
+    std::mutex mutex;
+    StringMap<uint32_t, BumpPtrAllocator> entries;
+    Symbol keywords[StringSymbol + 1];
+
+    Symbol add(StringRef text){
+        auto result = entries.insert(std::make_pair(text, (uint32_t)entries.size() + 1));
+        return Symbol(&*result.first);
+    }
+
+    void addKeywords(){
+        static const char* names[] = {"", "int", "double", "float", "char", "bool", "void", "string"};
+        keywords[0] = Symbol(nullptr);
+        for(uint32_t keyword=IntSymbol; keyword<=StringSymbol; keyword++)
+            keywords[keyword] = add(names[keyword]);
+    }
+
+public:
+    SymbolTable(){
+        addKeywords();
+    }
+
+    Symbol insert(StringRef text){
+        std::lock_guard<std::mutex> lock(mutex);
+        return add(text);
+    }
+
+    //clear() only destroys the entries, the bump allocator keeps their memory
+    //until it is reset
+    void reset(){
+        std::lock_guard<std::mutex> lock(mutex);
+        entries.clear();
+        entries.getAllocator().Reset();
+        addKeywords();
+    }
+
+    Symbol keyword(KeywordSymbol keyword) const{
+        return keywords[keyword];
+    }
+};
+
+static SymbolTable& symbolTable(){
+    static SymbolTable table;
+    return table;
+}
+
+//The symbols a thread has interned before. A parse names the same
+//identifiers over and over, so the -j workers mostly find them here
+//without taking the lock of the shared table.
+static thread_local StringMap<Symbol> threadSymbols;
+//bumped by resetSymbols, a thread drops its cache when it sees a new one
+static std::atomic<uint32_t> generation(0);
+static thread_local uint32_t threadGeneration = 0;
+
+Symbol intern(StringRef text){
+    uint32_t current = generation.load(std::memory_order_relaxed);
+    if( threadGeneration != current ){
+        threadSymbols.clear();
+        threadGeneration = current;
+    }
+    auto found = threadSymbols.find(text);
+    if( found != threadSymbols.end() )
+        return found->second;
+    Symbol symbol = symbolTable().insert(text);
+    threadSymbols.insert(std::make_pair(text, symbol));
+    return symbol;
+}
+
+Symbol keywordSymbol(KeywordSymbol keyword){
+    return symbolTable().keyword(keyword);
+}
+
+void resetSymbols(){
+    symbolTable().reset();
+    generation.fetch_add(1, std::memory_order_relaxed);
+}
@@ -0,0 +1,91 @@
+#ifndef SYMBOL_H
+#define SYMBOL_H
+
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+
+#include <functional>
+#include <ostream>
+#include <string>
+#include <stdint.h>
+
+//The type keywords are interned first, in this order, so their ids are fixed
+enum KeywordSymbol : uint32_t{
+    IntSymbol = 1,
+    DoubleSymbol,
+    FloatSymbol,
+    CharSymbol,
+    BoolSymbol,
+    VoidSymbol,
+    StringSymbol,
+};
+
+//An interned identifier or literal. Equal text means the same entry, so a
+//comparison is one pointer compare. The entries live until resetSymbols().
+//Trivial so it can live in the bison union; Symbol() is the empty symbol.
+class Symbol{
+public:
+    using Entry = llvm::StringMapEntry<uint32_t>;
+
+private:
+    const Entry* entry;
+
+    explicit Symbol(const Entry* entry): entry(entry){}
+    friend class SymbolTable;
+
+public:
+    Symbol() = default;
+
+    llvm::StringRef str() const{
+        return entry ? entry->getKey() : llvm::StringRef();
+    }
+
+    //Dense number in interning order, 0 for the empty symbol
+    uint32_t id() const{
+        return entry ? entry->getValue() : 0;
+    }
+
+    bool empty() const{
+        return entry == nullptr;
+    }
+
+    bool operator==(Symbol other) const{
+        return entry == other.entry;
+    }
+
+    bool operator!=(Symbol other) const{
+        return entry != other.entry;
+    }
+
+    bool operator<(Symbol other) const{
+        return id() < other.id();
+    }
+
+    const void* opaque() const{
+        return entry;
+    }
+};
+
+//Return the symbol of text, adding it on first sight. Safe to call from any thread.
+Symbol intern(llvm::StringRef text);
+
+Symbol keywordSymbol(KeywordSymbol keyword);
+
+//Free every symbol but the keywords, the ids start over. Only while no other
+//thread interns and nothing holds a symbol, the daemon calls it between requests.
+void resetSymbols();
+
+inline std::ostream& operator<<(std::ostream& out, Symbol symbol){
+    llvm::StringRef text = symbol.str();
+    return out.write(text.data(), text.size());
+}
+
+namespace std{
+template<> struct hash<Symbol>{
+    size_t operator()(Symbol symbol) const{
+        return std::hash<const void*>()(symbol.opaque());
+    }
+};
+}
+
+#endif //SYMBOL_H
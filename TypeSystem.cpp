@@ -52,22 +52,27 @@ TypeSystem::TypeSystem(LLVMContext &context): llvmContext(context){
     addCast(boolTy, doubleTy, llvm::CastInst::SIToFP);
 }
 
-void TypeSystem::addStructMember(string structName, string memType, string memName) {
+void TypeSystem::addStructMember(Symbol structName, Symbol memType, Symbol memName) {
     if( this->structTypes.find(structName) == this->structTypes.end() ){
         LogError("Unknown struct name");
     }
     this->structMembers[structName].push_back(std::make_pair(memType, memName));
 }
 
-void TypeSystem::addStructType(string name, llvm::StructType *type) {
+void TypeSystem::addStructType(Symbol name, llvm::StructType *type) {
     this->structTypes[name] = type;
+    this->structNames[type] = name;
     this->structMembers[name] = std::vector<TypeNamePair>();
 }
 
 Type *TypeSystem::getVarType(const NIdentifier& type) {
     assert(type.isType);
     if( type.isArray ){  
-        return PointerType::get(getVarType(type.name), 0);
+        Type* element = getVarType(type.name);
+        for(size_t i=type.arraySize.size()-1; i>=1; i--){
+            element = ArrayType::get(element, llvm::cast<NInteger>(type.arraySize[i])->value);
+        }
+        return PointerType::get(element, 0);
     }
 
     return getVarType(type.name);
@@ -75,10 +80,19 @@ Type *TypeSystem::getVarType(const NIdentifier& type) {
     return 0;
 }
 
+Type *TypeSystem::getArrayType(const NIdentifier& type) {
+    assert(type.isType && type.isArray);
+    Type* array = getVarType(type.name);
+    for(size_t i=type.arraySize.size(); i>=1; i--){
+        array = ArrayType::get(array, llvm::cast<NInteger>(type.arraySize[i-1])->value);
+    }
+    return array;
+}
+
 
 
-Value* TypeSystem::getDefaultValue(string typeStr, LLVMContext &context) {
-    Type* type = this->getVarType(typeStr);
+Value* TypeSystem::getDefaultValue(Symbol typeName, LLVMContext &context) {
+    Type* type = this->getVarType(typeName);
     if( type == this->intTy ){
         return ConstantInt::get(type, 0, true);
     }else if( type == this->doubleTy || type == this->floatTy ){
@@ -118,11 +132,16 @@ Value* TypeSystem::cast(Value *value, Type *type, BasicBlock *block) {
     return CastInst::Create(castTable[from][type], value, type, "cast", block);
 }
 
-bool TypeSystem::isStruct(string typeStr) const {
-    return this->structTypes.find(typeStr) != this->structTypes.end();
+bool TypeSystem::isStruct(Symbol typeName) const {
+    return this->structTypes.find(typeName) != this->structTypes.end();
 }
 
-int32_t TypeSystem::getStructMemberIndex(string structName, string memberName) {
+Symbol TypeSystem::getStructName(llvm::StructType* type) const {
+    auto it = this->structNames.find(type);
+    return it == this->structNames.end() ? Symbol() : it->second;
+}
+
+int32_t TypeSystem::getStructMemberIndex(Symbol structName, Symbol memberName) {
     if( this->structTypes.find(structName) == this->structTypes.end() ){
         LogError("Unknown struct name");
         return 0;
@@ -139,31 +158,30 @@ int32_t TypeSystem::getStructMemberIndex(string structName, string memberName) {
     return 0;
 }
 
-Type *TypeSystem::getVarType(string typeStr) {
-    if( typeStr.compare("bool") == 0 ){
-        return this->boolTy;
-    }
-    if( typeStr.compare("char") == 0 ){
-        return this->charTy;
-    }
-    if( typeStr.compare("void") == 0 ){
-        return this->voidTy;
-    }
-    if( typeStr.compare("int") == 0 ){
-        return this->intTy;
-    }
-    if( typeStr.compare("float") == 0 ){
-        return this->floatTy;
-    }
-    if( typeStr.compare("double") == 0 ){
-        return this->doubleTy;
-    }
-    if( typeStr.compare("string") == 0 ){
-        return this->stringTy;
+Type *TypeSystem::getVarType(Symbol typeName) {
+    //the keywords are interned first, their ids are fixed
+    switch (typeName.id()){
+        case BoolSymbol:
+            return this->boolTy;
+        case CharSymbol:
+            return this->charTy;
+        case VoidSymbol:
+            return this->voidTy;
+        case IntSymbol:
+            return this->intTy;
+        case FloatSymbol:
+            return this->floatTy;
+        case DoubleSymbol:
+            return this->doubleTy;
+        case StringSymbol:
+            return this->stringTy;
+        default:
+            break;
     }
 
-    if( this->structTypes.find(typeStr) != this->structTypes.end() )
-        return this->structTypes[typeStr];
+    auto it = this->structTypes.find(typeName);
+    if( it != this->structTypes.end() )
+        return it->second;
 
     return nullptr;
 }
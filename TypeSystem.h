@@ -19,7 +19,7 @@
 using std::string;
 using namespace llvm;
 
-#define TypeNamePair std::pair<std::string,std::string>
+#define TypeNamePair std::pair<Symbol,Symbol>
 #define ENABLE 1
 #define DISABLE 2
 
@@ -27,9 +27,12 @@ class TypeSystem{
 private:
     LLVMContext& llvmContext;
 
-    std::map<std::string, std::vector<TypeNamePair>> structMembers;
+    std::unordered_map<Symbol, std::vector<TypeNamePair>> structMembers;
 
-    std::map<std::string, llvm::StructType*> structTypes;
+    std::unordered_map<Symbol, llvm::StructType*> structTypes;
+    //the other way round: a bitcode module read into the same context
+    //(FunctionCache) can take the LLVM name of a struct first
+    std::unordered_map<llvm::StructType*, Symbol> structNames;
 
     std::map<Type*, std::map<Type*, CastInst::CastOps>> castTable;
 
@@ -50,18 +53,24 @@ public:
 
     TypeSystem(LLVMContext& context);
 
-    void addStructType(string structName, llvm::StructType*);
-    void addStructMember(string structName, string memType, string memName);
+    void addStructType(Symbol structName, llvm::StructType*);
+    void addStructMember(Symbol structName, Symbol memType, Symbol memName);
 
-    int32_t getStructMemberIndex(string structName, string memberName);
+    int32_t getStructMemberIndex(Symbol structName, Symbol memberName);
+    //The SubC name a struct type was declared with, not its LLVM name
+    Symbol getStructName(llvm::StructType* type) const;
 
+    //An array type is what the array decays to, a pointer to its first
+    //element: [3 x i32]* for int[2][3]
     Type* getVarType(const NIdentifier& type) ;
-    Type* getVarType(string typeStr) ;
+    Type* getVarType(Symbol typeName) ;
+    //The type an array variable is allocated with: [2 x [3 x i32]] for int[2][3]
+    Type* getArrayType(const NIdentifier& type) ;
 
-    Value* getDefaultValue(string typeStr, LLVMContext &context) ;
+    Value* getDefaultValue(Symbol typeName, LLVMContext &context) ;
     Value* cast(Value* value, Type* type, BasicBlock* block) ;
 
-    bool isStruct(string typeStr) const;
+    bool isStruct(Symbol typeName) const;
 
     static string llvmTypeToStr(Value* value) ;
     static string llvmTypeToStr(Type* type) ;
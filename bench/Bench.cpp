@@ -0,0 +1,332 @@
+//Compile throughput benchmark of the SubC compiler.
+//
+//  bench generate [shape switches]        write one synthetic program to stdout
+//  bench run [--compiler=./compiler] [--opt=-O0]... [--runs=3] [--out=file]
+//            [--size=name:functions,statements,depth,dims,structs]...
+//  bench compare old.json new.json        print the change of every size and phase
+#include <json/json.h>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Generator.h"
+
+using std::string;
+using Clock = std::chrono::steady_clock;
+
+struct BenchSize{
+    string name;
+    ProgramShape shape;
+};
+
+struct RunResult{
+    double wallMs = 0;
+    long peakRssKB = 0;
+    std::map<string, double> phaseMs;
+};
+
+static const char* optionValue(const char* arg, const char* name){
+    size_t length = strlen(name);
+    if( strncmp(arg, name, length) == 0 && arg[length] == '=' )
+        return arg + length + 1;
+    return nullptr;
+}
+
+static bool parseShape(const char* arg, ProgramShape& shape){
+    if( const char* value = optionValue(arg, "--functions") )
+        shape.functions = atoi(value);
+    else if( const char* value = optionValue(arg, "--statements") )
+        shape.statements = atoi(value);
+    else if( const char* value = optionValue(arg, "--depth") )
+        shape.depth = atoi(value);
+    else if( const char* value = optionValue(arg, "--array-dims") )
+        shape.arrayDims = atoi(value);
+    else if( const char* value = optionValue(arg, "--structs") )
+        shape.structs = atoi(value);
+    else if( const char* value = optionValue(arg, "--seed") )
+        shape.seed = atoi(value);
+    else
+        return false;
+    return true;
+}
+
+//name:functions,statements,depth,dims,structs
+static bool parseSize(const char* value, BenchSize& size){
+    const char* colon = strchr(value, ':');
+    if( !colon )
+        return false;
+    size.name.assign(value, colon - value);
+    return sscanf(colon + 1, "%u,%u,%u,%u,%u", &size.shape.functions, &size.shape.statements,
+                  &size.shape.depth, &size.shape.arrayDims, &size.shape.structs) == 5;
+}
+
+static std::vector<BenchSize> defaultSizes(){
+    std::vector<BenchSize> sizes(4);
+    parseSize("tiny:10,10,2,1,1", sizes[0]);
+    parseSize("small:100,20,3,2,4", sizes[1]);
+    parseSize("medium:500,40,4,2,8", sizes[2]);
+    parseSize("large:2000,60,4,3,16", sizes[3]);
+    return sizes;
+}
+
+static size_t countLines(const string& text){
+    size_t lines = 0;
+    for(char c: text)
+        lines += c == '\n';
+    return lines;
+}
+
+//Sum the phase spans of a -ftime-trace file; spans of single functions carry
+//the function name, phases are named after their category
+static bool readTrace(const string& path, std::map<string, double>& phaseMs){
+    std::ifstream file(path);
+    Json::Value trace;
+    Json::CharReaderBuilder builder;
+    string errors;
+    if( !file.is_open() || !Json::parseFromStream(builder, file, &trace, &errors) )
+        return false;
+    for(auto& event: trace["traceEvents"]){
+        string name = event["name"].asString();
+        if( name == event["cat"].asString() )
+            phaseMs[name] += event["dur"].asDouble() / 1000.0;
+    }
+    return true;
+}
+
+static bool runCompiler(const std::vector<string>& command, RunResult& result){
+    std::vector<char*> argv;
+    for(auto& arg: command)
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    argv.push_back(nullptr);
+
+    auto start = Clock::now();
+    pid_t child = fork();
+    if( child < 0 ){
+        perror("fork");
+        return false;
+    }
+    if( child == 0 ){
+        //the compiler's own diagnostics stay visible, its stdout does not matter
+        if( !freopen("/dev/null", "w", stdout) )
+            _exit(127);
+        execvp(argv[0], argv.data());
+        perror(argv[0]);
+        _exit(127);
+    }
+
+    int status;
+    rusage usage;
+    if( wait4(child, &status, 0, &usage) < 0 ){
+        perror("wait4");
+        return false;
+    }
+    result.wallMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+#ifdef __APPLE__
+    //bytes on macOS, KB on Linux
+    result.peakRssKB = usage.ru_maxrss / 1024;
+#else
+    result.peakRssKB = usage.ru_maxrss;
+#endif
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+static string currentCommit(){
+    string commit;
+    if( FILE* pipe = popen("git rev-parse --short HEAD 2>/dev/null", "r") ){
+        char line[64];
+        if( fgets(line, sizeof(line), pipe) )
+            commit = line;
+        pclose(pipe);
+    }
+    while( !commit.empty() && (commit.back() == '\n' || commit.back() == '\r') )
+        commit.pop_back();
+    return commit.empty() ? "unknown" : commit;
+}
+
+static int runBenchmark(int argc, char** argv){
+    string compiler = "./compiler";
+    //compiler switches, --opt may be given several times
+    std::vector<string> opts;
+    string out = "bench/results.json";
+    string workDir = "bench/out";
+    unsigned runs = 3;
+    std::vector<BenchSize> sizes;
+
+    for(int i=0; i<argc; i++){
+        BenchSize size;
+        if( const char* value = optionValue(argv[i], "--compiler") )
+            compiler = value;
+        else if( const char* value = optionValue(argv[i], "--opt") )
+            opts.push_back(value);
+        else if( const char* value = optionValue(argv[i], "--out") )
+            out = value;
+        else if( const char* value = optionValue(argv[i], "--work-dir") )
+            workDir = value;
+        else if( const char* value = optionValue(argv[i], "--runs") )
+            runs = std::max(1, atoi(value));
+        else if( const char* value = optionValue(argv[i], "--size") ){
+            if( !parseSize(value, size) ){
+                std::cerr << "Malformed size " << value << ", expected name:functions,statements,depth,dims,structs" << std::endl;
+                return 1;
+            }
+            sizes.push_back(size);
+        }else{
+            std::cerr << "Unknown switch " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+    if( sizes.empty() )
+        sizes = defaultSizes();
+    if( opts.empty() )
+        opts.push_back("-O0");
+    string opt;
+    for(auto& o: opts)
+        opt += (opt.empty() ? "" : " ") + o;
+
+    string mkdir = "mkdir -p " + workDir;
+    if( system(mkdir.c_str()) != 0 )
+        return 1;
+
+    Json::Value report;
+    report["commit"] = currentCommit();
+    report["compiler"] = compiler;
+    report["opt"] = opt;
+    report["runs"] = runs;
+
+    for(auto& size: sizes){
+        string source = generateProgram(size.shape);
+        string input = workDir + "/" + size.name + ".input";
+        string trace = workDir + "/" + size.name + ".trace.json";
+        std::ofstream(input) << source;
+
+        std::vector<string> command;
+        command.push_back(compiler);
+        for(auto& o: opts){
+            if( !o.empty() )
+                command.push_back(o);
+        }
+        command.push_back("-ftime-trace=" + trace);
+        command.push_back("-o");
+        command.push_back(workDir + "/" + size.name + ".o");
+        command.push_back(input);
+
+        //the fastest run is the one least disturbed by the rest of the machine
+        RunResult best;
+        bool failed = false;
+        for(unsigned run=0; run<runs; run++){
+            RunResult result;
+            if( !runCompiler(command, result) || !readTrace(trace, result.phaseMs) ){
+                failed = true;
+                break;
+            }
+            if( run == 0 || result.wallMs < best.wallMs )
+                best = result;
+        }
+
+        size_t lines = countLines(source);
+        Json::Value entry;
+        entry["size"] = size.name;
+        entry["functions"] = size.shape.functions;
+        entry["statements"] = size.shape.statements;
+        entry["depth"] = size.shape.depth;
+        entry["array_dims"] = size.shape.arrayDims;
+        entry["structs"] = size.shape.structs;
+        entry["lines"] = (Json::UInt64)lines;
+        entry["bytes"] = (Json::UInt64)source.size();
+        entry["ok"] = !failed;
+        if( !failed ){
+            entry["wall_ms"] = best.wallMs;
+            entry["lines_per_second"] = lines / (best.wallMs / 1000.0);
+            entry["peak_rss_kb"] = (Json::Int64)best.peakRssKB;
+            for(auto& phase: best.phaseMs)
+                entry["phases_ms"][phase.first] = phase.second;
+        }
+        report["results"].append(entry);
+
+        std::cout << size.name << ": " << lines << " lines, ";
+        if( failed )
+            std::cout << "FAILED" << std::endl;
+        else
+            std::cout << best.wallMs << " ms, " << (uint64_t)(lines / (best.wallMs / 1000.0)) << " lines/s" << std::endl;
+    }
+
+    std::ofstream file(out);
+    Json::StreamWriterBuilder writer;
+    writer["indentation"] = "  ";
+    file << Json::writeString(writer, report) << std::endl;
+    std::cout << "results written to " << out << std::endl;
+    return 0;
+}
+
+static bool readReport(const string& path, Json::Value& report){
+    std::ifstream file(path);
+    Json::CharReaderBuilder builder;
+    string errors;
+    if( !file.is_open() || !Json::parseFromStream(builder, file, &report, &errors) ){
+        std::cerr << path << ": cannot read " << errors << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static void printChange(const string& what, double before, double after){
+    printf("  %-14s %12.3f %12.3f %+8.1f%%\n", what.c_str(), before, after,
+           before > 0 ? (after - before) * 100.0 / before : 0.0);
+}
+
+static int compareReports(const string& oldPath, const string& newPath){
+    Json::Value before, after;
+    if( !readReport(oldPath, before) || !readReport(newPath, after) )
+        return 1;
+
+    printf("%s -> %s\n", before["commit"].asCString(), after["commit"].asCString());
+    for(auto& entry: after["results"]){
+        for(auto& old: before["results"]){
+            if( old["size"] != entry["size"] || !old["ok"].asBool() || !entry["ok"].asBool() )
+                continue;
+            printf("%s\n", entry["size"].asCString());
+            printChange("wall ms", old["wall_ms"].asDouble(), entry["wall_ms"].asDouble());
+            printChange("lines/s", old["lines_per_second"].asDouble(), entry["lines_per_second"].asDouble());
+            printChange("peak RSS KB", old["peak_rss_kb"].asDouble(), entry["peak_rss_kb"].asDouble());
+            for(auto& phase: entry["phases_ms"].getMemberNames())
+                printChange(phase, old["phases_ms"][phase].asDouble(), entry["phases_ms"][phase].asDouble());
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char** argv){
+    string command = argc > 1 ? argv[1] : "";
+    if( command == "generate" ){
+        ProgramShape shape;
+        for(int i=2; i<argc; i++){
+            if( !parseShape(argv[i], shape) ){
+                std::cerr << "Unknown switch " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        std::cout << generateProgram(shape);
+        return 0;
+    }
+    if( command == "run" )
+        return runBenchmark(argc - 2, argv + 2);
+    if( command == "compare" && argc == 4 )
+        return compareReports(argv[2], argv[3]);
+
+    std::cerr << "Usage: " << argv[0] << " generate [--functions=N] [--statements=N] [--depth=N] [--array-dims=N] [--structs=N] [--seed=N]" << std::endl
+              << "       " << argv[0] << " run [--compiler=./compiler] [--opt=-O0]... [--runs=3] [--out=bench/results.json]" << std::endl
+              << "                 [--size=name:functions,statements,depth,dims,structs]..." << std::endl
+              << "       " << argv[0] << " compare old.json new.json" << std::endl;
+    return 1;
+}
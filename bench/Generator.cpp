@@ -0,0 +1,204 @@
+#include <sstream>
+#include <stdint.h>
+
+#include "Generator.h"
+
+using std::string;
+
+//Every array dimension has this extent, indices are reduced modulo it
+static const unsigned arrayExtent = 4;
+
+//xorshift, std::mt19937 with the std distributions is not the same everywhere
+class Random{
+private:
+    uint64_t state;
+
+public:
+    explicit Random(uint64_t seed): state(seed * 0x9E3779B97F4A7C15ull + 1){}
+
+    unsigned below(unsigned bound){
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return bound ? (unsigned)(state % bound) : 0;
+    }
+};
+
+class ProgramWriter{
+private:
+    const ProgramShape& shape;
+    Random random;
+    std::ostringstream out;
+
+    unsigned function = 0;
+    unsigned budget = 0;
+    //loops enclosing the statement being written
+    unsigned loops = 0;
+
+    void indent(unsigned level){
+        for(unsigned i=0; i<level; i++)
+            out << "    ";
+    }
+
+    string operand(){
+        switch (random.below(5)){
+            case 0:
+                return "a";
+            case 1:
+                return "b";
+            case 2:
+                return std::to_string(random.below(100));
+            default:
+                return "r";
+        }
+    }
+
+    string arithmetic(){
+        static const char* operators[] = {" + ", " - ", " * "};
+        string expr = operand();
+        unsigned terms = 1 + random.below(3);
+        for(unsigned i=0; i<terms; i++)
+            expr += operators[random.below(3)] + operand();
+        if( random.below(4) == 0 )
+            expr = "(" + expr + ") % " + std::to_string(2 + random.below(7));
+        return expr;
+    }
+
+    string arrayElement(){
+        string element = "arr";
+        for(unsigned d=0; d<shape.arrayDims; d++){
+            if( loops > 0 && random.below(2) )
+                element += "[i" + std::to_string(random.below(loops)) + " % " + std::to_string(arrayExtent) + "]";
+            else
+                element += "[" + std::to_string(random.below(arrayExtent)) + "]";
+        }
+        return element;
+    }
+
+    void simpleStatement(unsigned level){
+        indent(level);
+        unsigned kind = random.below(6);
+        if( kind == 1 && shape.arrayDims > 0 ){
+            out << arrayElement() << " = " << arithmetic();
+        }else if( kind == 2 && shape.arrayDims > 0 ){
+            out << "r = r + " << arrayElement();
+        }else if( kind == 3 && shape.structs > 0 ){
+            if( random.below(2) )
+                out << "s.x = " << arithmetic();
+            else
+                out << "r = r + s.y";
+        }else if( kind == 4 && function > 0 ){
+            out << "r = r + f" << random.below(function) << "(" << operand() << ", " << operand() << ")";
+        }else if( kind == 5 ){
+            out << "d = d * 0.5 + 1.25";
+        }else{
+            out << "r = " << arithmetic();
+        }
+        out << "\n";
+    }
+
+    void statements(unsigned count, unsigned level, unsigned depth){
+        for(unsigned i=0; i<count && budget > 0; i++){
+            budget--;
+            unsigned nested = budget > 1 && depth < shape.depth ? random.below(4) : 3;
+            if( nested == 3 ){
+                simpleStatement(level);
+                continue;
+            }
+
+            unsigned inner = 1 + random.below(4);
+            if( nested == 0 ){
+                indent(level);
+                out << "if(r > " << operand() << "){\n";
+                statements(inner, level + 1, depth + 1);
+                indent(level);
+                out << "}else{\n";
+                statements(inner, level + 1, depth + 1);
+                indent(level);
+                out << "}\n";
+            }else if( nested == 1 ){
+                string counter = "i" + std::to_string(loops);
+                indent(level);
+                out << "for(" << counter << "=0;" << counter << "<" << 2 + random.below(14) << ";"
+                    << counter << "=" << counter << "+1){\n";
+                loops++;
+                statements(inner, level + 1, depth + 1);
+                loops--;
+                indent(level);
+                out << "}\n";
+            }else{
+                string counter = "i" + std::to_string(loops);
+                indent(level);
+                out << counter << " = 0\n";
+                indent(level);
+                out << "while(" << counter << " < " << 2 + random.below(14) << "){\n";
+                loops++;
+                statements(inner, level + 1, depth + 1);
+                loops--;
+                indent(level + 1);
+                out << counter << " = " << counter << " + 1\n";
+                indent(level);
+                out << "}\n";
+            }
+        }
+    }
+
+    void functionDefinition(){
+        out << "int f" << function << "(int a, int b){\n";
+        out << "    int r = a\n";
+        out << "    double d = 0.0\n";
+        for(unsigned level=0; level<shape.depth; level++)
+            out << "    int i" << level << " = 0\n";
+        if( shape.arrayDims > 0 ){
+            out << "    int";
+            for(unsigned d=0; d<shape.arrayDims; d++)
+                out << "[" << arrayExtent << "]";
+            out << " arr\n";
+        }
+        if( shape.structs > 0 ){
+            out << "    struct S" << function % shape.structs << " s\n";
+            out << "    s.y = b\n";
+        }
+
+        budget = shape.statements;
+        while( budget > 0 )
+            statements(budget, 1, 0);
+
+        out << "    return r\n";
+        out << "}\n\n";
+    }
+
+public:
+    ProgramWriter(const ProgramShape& shape): shape(shape), random(shape.seed){}
+
+    string write(){
+        out << "extern int printf(string format, ...)\n";
+        out << "extern int puts(string s)\n\n";
+
+        for(unsigned k=0; k<shape.structs; k++){
+            out << "struct S" << k << "{\n";
+            out << "    int x\n";
+            out << "    int y\n";
+            out << "    double z\n";
+            out << "}\n\n";
+        }
+
+        for(function=0; function<shape.functions; function++)
+            functionDefinition();
+
+        out << "int main(){\n";
+        out << "    int t = 0\n";
+        for(unsigned k=0; k<shape.functions; k++)
+            out << "    t = t + f" << k << "(" << k << ", " << k + 1 << ") % 1000\n";
+        out << "    printf(\"%d\", t)\n";
+        out << "    puts(\"\")\n";
+        out << "    return 0\n";
+        out << "}\n";
+        return out.str();
+    }
+};
+
+string generateProgram(const ProgramShape& shape){
+    ProgramWriter writer(shape);
+    return writer.write();
+}
@@ -0,0 +1,25 @@
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include <string>
+
+//The size of a synthetic SubC program
+struct ProgramShape{
+    //functions besides main, function k calls functions below k
+    unsigned functions = 10;
+    //statements in every function body, nested ones included
+    unsigned statements = 10;
+    //deepest nesting of if/for/while blocks
+    unsigned depth = 2;
+    //dimensions of the local array of every function, 0 for none
+    unsigned arrayDims = 1;
+    //struct declarations, every function has a local of one of them
+    unsigned structs = 1;
+    unsigned seed = 1;
+};
+
+//Generate a program of the given shape. The same shape and seed give the same
+//text on every platform, so results of different commits stay comparable.
+std::string generateProgram(const ProgramShape& shape);
+
+#endif //GENERATOR_H
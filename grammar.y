@@ -1,13 +1,36 @@
 %{
 	#include "ASTNodes.h"
 	#include <stdio.h>
-	NBlock* programBlock;
-	extern int yylex();
-	void yyerror(const char* s)
+%}
+%code requires {
+	struct ParseState;
+}
+%code {
+	#include "Parser.h"
+	//the parse state is handed on to the scanner it names
+	int yylex(YYSTYPE* value, ParseState* state);
+	//nodes and lists go to the arena of the tree being parsed
+	#define NEW(T) state->arena->make<T>
+	#define APPEND(list, item) (list)->push_back(*state->arena, item)
+	void yyerror(ParseState* state, const char* s)
 	{
 		printf("Error: %s\n", s);
 	}
-%}
+	//@name or @name(value) added to hints, false after reporting a bad one
+	bool addLoopHint(ParseState* state, LoopHints* hints, Symbol name, uint64_t value, bool hasValue)
+	{
+		std::string error;
+		if( hints->set(name.str(), value, hasValue, error) )
+			return true;
+		yyerror(state, error.c_str());
+		return false;
+	}
+}
+
+%define api.pure full
+%parse-param { ParseState* state }
+%lex-param { ParseState* state }
+
 %union
 {
 	NBlock* block;
@@ -16,18 +39,26 @@
 	NIdentifier* ident;
 	NVariableDeclaration* var_decl;
 	NArrayIndex* index;
-	std::vector<shared_ptr<NVariableDeclaration>>* varvec;
-	std::vector<shared_ptr<NExpression>>* exprvec;
-	std::string* string;
+	VariableList* varvec;
+	ExpressionList* exprvec;
+	LoopHints* hints;
+	Symbol symbol;
+	//a literal between its quotes, in place in the source buffer
+	struct { const char* data; size_t length; } text;
+	uint64_t integer;
+	double real;
 	int token;
-	double test;
 }
 
-%token <string> TIDENTIFIER TINTEGER TDOUBLE TYINT TYDOUBLE TYFLOAT TYCHAR TYBOOL TYVOID TYSTRING TEXTERN TLITERAL
+%token <symbol> TIDENTIFIER TYINT TYDOUBLE TYFLOAT TYCHAR TYBOOL TYVOID TYSTRING
+%token <text> TLITERAL
+%token <integer> TINTEGER
+%token <real> TDOUBLE
 %token <token> TCEQ TCNE TCLT TCLE TCGT TCGE TEQUAL
 %token <token> TLPAREN TRPAREN TLBRACE TRBRACE TCOMMA TDOT TSEMICOLON TLBRACKET TRBRACKET TQUOTATION
 %token <token> TPLUS TMINUS TMUL TDIV TAND TOR TXOR TMOD TNEG TNOT TSHIFTL TSHIFTR
-%token <token> TIF TELSE TFOR TWHILE TRETURN TSTRUCT
+%token <token> TIF TELSE TFOR TWHILE TRETURN TSTRUCT TEXTERN
+%token <token> TAT TELLIPSIS
 
 %type <index> array_index
 %type <ident> ident primary_typename array_typename struct_typename typename
@@ -37,6 +68,7 @@
 %type <block> program stmts block
 %type <stmt> stmt var_decl func_decl struct_decl if_stmt for_stmt while_stmt
 %type <token> comparison
+%type <hints> loop_hints
 
 %left TPLUS TMINUS
 %left TMUL TDIV TMOD
@@ -44,38 +76,40 @@
 %start program
 
 %%
-program : stmts { programBlock = $1; }
+program : stmts { state->arena->root = $1; }
 				;
-stmts : stmt { $$ = new NBlock(); $$->statements->push_back(shared_ptr<NStatement>($1)); }
-			| stmts stmt { $1->statements->push_back(shared_ptr<NStatement>($2)); }
+stmts : stmt { $$ = NEW(NBlock)(); APPEND(&$$->statements, $1); }
+			| stmts stmt { APPEND(&$1->statements, $2); }
 			;
 stmt : var_decl | func_decl | struct_decl
-		 | expr { $$ = new NExpressionStatement(shared_ptr<NExpression>($1)); }
-		 | TRETURN expr { $$ = new NReturnStatement(shared_ptr<NExpression>($2)); }
+		 | expr { $$ = NEW(NExpressionStatement)($1); }
+		 | TRETURN expr { $$ = NEW(NReturnStatement)($2); }
 		 | if_stmt
 		 | for_stmt
 		 | while_stmt
+		 | loop_hints for_stmt { llvm::cast<NForStatement>($2)->hints = *$1; $$ = $2; }
+		 | loop_hints while_stmt { llvm::cast<NForStatement>($2)->hints = *$1; $$ = $2; }
 		 ;
 
 block : TLBRACE stmts TRBRACE { $$ = $2; }
-			| TLBRACE TRBRACE { $$ = new NBlock(); }
+			| TLBRACE TRBRACE { $$ = NEW(NBlock)(); }
 			;
 
-primary_typename : TYINT { $$ = new NIdentifier(*$1); $$->isType = true;  delete $1; }
-					| TYDOUBLE { $$ = new NIdentifier(*$1); $$->isType = true; delete $1; }
-					| TYFLOAT { $$ = new NIdentifier(*$1); $$->isType = true; delete $1; }
-					| TYCHAR { $$ = new NIdentifier(*$1); $$->isType = true; delete $1; }
-					| TYBOOL { $$ = new NIdentifier(*$1); $$->isType = true; delete $1; }
-					| TYVOID { $$ = new NIdentifier(*$1); $$->isType = true; delete $1; }
-					| TYSTRING { $$ = new NIdentifier(*$1); $$->isType = true; delete $1; }
+primary_typename : TYINT { $$ = NEW(NIdentifier)($1); $$->isType = true; }
+					| TYDOUBLE { $$ = NEW(NIdentifier)($1); $$->isType = true; }
+					| TYFLOAT { $$ = NEW(NIdentifier)($1); $$->isType = true; }
+					| TYCHAR { $$ = NEW(NIdentifier)($1); $$->isType = true; }
+					| TYBOOL { $$ = NEW(NIdentifier)($1); $$->isType = true; }
+					| TYVOID { $$ = NEW(NIdentifier)($1); $$->isType = true; }
+					| TYSTRING { $$ = NEW(NIdentifier)($1); $$->isType = true; }
 
 array_typename : primary_typename TLBRACKET TINTEGER TRBRACKET { 
 					$1->isArray = true; 
-					$1->arraySize->push_back(make_shared<NInteger>(atol($3->c_str()))); 
+					APPEND(&$1->arraySize, NEW(NInteger)($3)); 
 					$$ = $1; 
 				}
 				| array_typename TLBRACKET TINTEGER TRBRACKET {
-					$1->arraySize->push_back(make_shared<NInteger>(atol($3->c_str())));
+					APPEND(&$1->arraySize, NEW(NInteger)($3));
 					$$ = $1;
 				}
 
@@ -88,84 +122,106 @@ typename : primary_typename { $$ = $1; }
 			| array_typename { $$ = $1; }
 			| struct_typename { $$ = $1; }
 
-var_decl : typename ident { $$ = new NVariableDeclaration(shared_ptr<NIdentifier>($1), shared_ptr<NIdentifier>($2), nullptr); }
-				 | typename ident TEQUAL expr { $$ = new NVariableDeclaration(shared_ptr<NIdentifier>($1), shared_ptr<NIdentifier>($2), shared_ptr<NExpression>($4)); }
+var_decl : typename ident { $$ = NEW(NVariableDeclaration)($1, $2, nullptr); }
+				 | typename ident TEQUAL expr { $$ = NEW(NVariableDeclaration)($1, $2, $4); }
 				 | typename ident TEQUAL TLBRACKET call_args TRBRACKET {
-					 $$ = new NArrayInitialization(make_shared<NVariableDeclaration>(shared_ptr<NIdentifier>($1), shared_ptr<NIdentifier>($2), nullptr), shared_ptr<ExpressionList>($5));
+					 $$ = NEW(NArrayInitialization)(NEW(NVariableDeclaration)($1, $2, nullptr), *$5);
 				 }
 				 ;
 
 func_decl : typename ident TLPAREN func_decl_args TRPAREN block
-				{ $$ = new NFunctionDeclaration(shared_ptr<NIdentifier>($1), shared_ptr<NIdentifier>($2), shared_ptr<VariableList>($4), shared_ptr<NBlock>($6));  }
-			| TEXTERN typename ident TLPAREN func_decl_args TRPAREN { $$ = new NFunctionDeclaration(shared_ptr<NIdentifier>($2), shared_ptr<NIdentifier>($3), shared_ptr<VariableList>($5), nullptr, true); }
+				{ $$ = NEW(NFunctionDeclaration)($1, $2, *$4, $6);  }
+			| TEXTERN typename ident TLPAREN func_decl_args TRPAREN { $$ = NEW(NFunctionDeclaration)($2, $3, *$5, nullptr, true); }
+			| TEXTERN typename ident TLPAREN func_decl_args TCOMMA TELLIPSIS TRPAREN {
+				if( $5->empty() ){
+					yyerror(state, "... needs a named parameter before it");
+					YYERROR;
+				}
+				$$ = NEW(NFunctionDeclaration)($2, $3, *$5, nullptr, true, true);
+			}
 
-func_decl_args : /* blank */ { $$ = new VariableList(); }
-							 | var_decl { $$ = new VariableList(); $$->push_back(shared_ptr<NVariableDeclaration>($<var_decl>1)); }
-							 | func_decl_args TCOMMA var_decl { $1->push_back(shared_ptr<NVariableDeclaration>($<var_decl>3)); }
+func_decl_args : /* blank */ { $$ = NEW(VariableList)(); }
+							 | var_decl { $$ = NEW(VariableList)(); APPEND($$, $<var_decl>1); }
+							 | func_decl_args TCOMMA var_decl { APPEND($1, $<var_decl>3); }
 							 ;
 
-ident : TIDENTIFIER { $$ = new NIdentifier(*$1); delete $1; }
+ident : TIDENTIFIER { $$ = NEW(NIdentifier)($1); }
 			;
 
-numeric : TINTEGER { $$ = new NInteger(atol($1->c_str())); }
-				| TDOUBLE { $$ = new NDouble(atof($1->c_str())); }
+numeric : TINTEGER { $$ = NEW(NInteger)($1); }
+				| TDOUBLE { $$ = NEW(NDouble)($1); }
 				;
 expr : 	assign { $$ = $1; }
-		 | ident TLPAREN call_args TRPAREN { $$ = new NMethodCall(shared_ptr<NIdentifier>($1), shared_ptr<ExpressionList>($3)); }
+		 | ident TLPAREN call_args TRPAREN { $$ = NEW(NMethodCall)($1, *$3); }
 		 | ident { $<ident>$ = $1; }
-		 | ident TDOT ident { $$ = new NStructMember(shared_ptr<NIdentifier>($1), shared_ptr<NIdentifier>($3)); }
+		 | ident TDOT ident { $$ = NEW(NStructMember)($1, $3); }
 		 | numeric
-		 | expr comparison expr { $$ = new NBinaryOperator(shared_ptr<NExpression>($1), $2, shared_ptr<NExpression>($3)); }
-		 | expr TMOD expr { $$ = new NBinaryOperator(shared_ptr<NExpression>($1), $2, shared_ptr<NExpression>($3)); }
-		 | expr TMUL expr { $$ = new NBinaryOperator(shared_ptr<NExpression>($1), $2, shared_ptr<NExpression>($3)); }
-		 | expr TDIV expr { $$ = new NBinaryOperator(shared_ptr<NExpression>($1), $2, shared_ptr<NExpression>($3)); }
-		 | expr TPLUS expr { $$ = new NBinaryOperator(shared_ptr<NExpression>($1), $2, shared_ptr<NExpression>($3)); }
-		 | expr TMINUS expr { $$ = new NBinaryOperator(shared_ptr<NExpression>($1), $2, shared_ptr<NExpression>($3)); }
+		 | expr comparison expr { $$ = NEW(NBinaryOperator)($1, $2, $3); }
+		 | expr TMOD expr { $$ = NEW(NBinaryOperator)($1, $2, $3); }
+		 | expr TMUL expr { $$ = NEW(NBinaryOperator)($1, $2, $3); }
+		 | expr TDIV expr { $$ = NEW(NBinaryOperator)($1, $2, $3); }
+		 | expr TPLUS expr { $$ = NEW(NBinaryOperator)($1, $2, $3); }
+		 | expr TMINUS expr { $$ = NEW(NBinaryOperator)($1, $2, $3); }
 		 | TLPAREN expr TRPAREN { $$ = $2; }
 		 | TMINUS expr { $$ = nullptr; /* TODO */ }
 		 | array_index { $$ = $1; }
-		 | TLITERAL { $$ = new NLiteral(*$1); delete $1; }
+		 | TLITERAL { $$ = NEW(NLiteral)(llvm::StringRef($1.data, $1.length)); }
 		 ;
 
 array_index : ident TLBRACKET expr TRBRACKET 
-				{ $$ = new NArrayIndex(shared_ptr<NIdentifier>($1), shared_ptr<NExpression>($3)); }
+				{ $$ = NEW(NArrayIndex)(*state->arena, $1, $3); }
 				| array_index TLBRACKET expr TRBRACKET 
 					{ 	
-						$1->expressions->push_back(shared_ptr<NExpression>($3));
+						APPEND(&$1->expressions, $3);
 						$$ = $1;
 					}
-assign : ident TEQUAL expr { $$ = new NAssignment(shared_ptr<NIdentifier>($1), shared_ptr<NExpression>($3)); }
+assign : ident TEQUAL expr { $$ = NEW(NAssignment)($1, $3); }
 			| array_index TEQUAL expr {
-				$$ = new NArrayAssignment(shared_ptr<NArrayIndex>($1), shared_ptr<NExpression>($3));
+				$$ = NEW(NArrayAssignment)($1, $3);
 			}
 			| ident TDOT ident TEQUAL expr {
-				auto member = make_shared<NStructMember>(shared_ptr<NIdentifier>($1), shared_ptr<NIdentifier>($3)); 
-				$$ = new NStructAssignment(member, shared_ptr<NExpression>($5)); 
+				auto member = NEW(NStructMember)($1, $3); 
+				$$ = NEW(NStructAssignment)(member, $5); 
 			}
 			;
 
-call_args : /* blank */ { $$ = new ExpressionList(); }
-					| expr { $$ = new ExpressionList(); $$->push_back(shared_ptr<NExpression>($1)); }
-					| call_args TCOMMA expr { $1->push_back(shared_ptr<NExpression>($3)); }
+call_args : /* blank */ { $$ = NEW(ExpressionList)(); }
+					| expr { $$ = NEW(ExpressionList)(); APPEND($$, $1); }
+					| call_args TCOMMA expr { APPEND($1, $3); }
 comparison : TCEQ | TCNE | TCLT | TCLE | TCGT | TCGE
 				 | TAND | TOR | TXOR | TSHIFTL | TSHIFTR
 					 ;
-if_stmt : TIF expr block { $$ = new NIfStatement(shared_ptr<NExpression>($2), shared_ptr<NBlock>($3)); }
-		| TIF expr block TELSE block { $$ = new NIfStatement(shared_ptr<NExpression>($2), shared_ptr<NBlock>($3), shared_ptr<NBlock>($5)); }
+if_stmt : TIF expr block { $$ = NEW(NIfStatement)($2, $3); }
+		| TIF expr block TELSE block { $$ = NEW(NIfStatement)($2, $3, $5); }
 		| TIF expr block TELSE if_stmt { 
-			auto blk = new NBlock(); 
-			blk->statements->push_back(shared_ptr<NStatement>($5)); 
-			$$ = new NIfStatement(shared_ptr<NExpression>($2), shared_ptr<NBlock>($3), shared_ptr<NBlock>(blk)); 
+			auto blk = NEW(NBlock)(); 
+			APPEND(&blk->statements, $5); 
+			$$ = NEW(NIfStatement)($2, $3, blk); 
 		}
 
-for_stmt : TFOR TLPAREN expr TSEMICOLON expr TSEMICOLON expr TRPAREN block { $$ = new NForStatement(shared_ptr<NBlock>($9), shared_ptr<NExpression>($3), shared_ptr<NExpression>($5), shared_ptr<NExpression>($7)); }
+for_stmt : TFOR TLPAREN expr TSEMICOLON expr TSEMICOLON expr TRPAREN block { $$ = NEW(NForStatement)($9, $3, $5, $7); }
 		
-while_stmt : TWHILE TLPAREN expr TRPAREN block { $$ = new NForStatement(shared_ptr<NBlock>($5), nullptr, shared_ptr<NExpression>($3), nullptr); }
+while_stmt : TWHILE TLPAREN expr TRPAREN block { $$ = NEW(NForStatement)($5, nullptr, $3, nullptr); }
+
+loop_hints : TAT TIDENTIFIER {
+				$$ = NEW(LoopHints)();
+				if( !addLoopHint(state, $$, $2, 0, false) ) YYERROR;
+			}
+			| TAT TIDENTIFIER TLPAREN TINTEGER TRPAREN {
+				$$ = NEW(LoopHints)();
+				if( !addLoopHint(state, $$, $2, $4, true) ) YYERROR;
+			}
+			| loop_hints TAT TIDENTIFIER {
+				if( !addLoopHint(state, $1, $3, 0, false) ) YYERROR;
+			}
+			| loop_hints TAT TIDENTIFIER TLPAREN TINTEGER TRPAREN {
+				if( !addLoopHint(state, $1, $3, $5, true) ) YYERROR;
+			}
 
-struct_decl : TSTRUCT ident TLBRACE struct_members TRBRACE {$$ = new NStructDeclaration(shared_ptr<NIdentifier>($2), shared_ptr<VariableList>($4)); }
+struct_decl : TSTRUCT ident TLBRACE struct_members TRBRACE {$$ = NEW(NStructDeclaration)($2, *$4); }
 
-struct_members : /* blank */ { $$ = new VariableList(); }
-				| var_decl { $$ = new VariableList(); $$->push_back(shared_ptr<NVariableDeclaration>($<var_decl>1)); }
-				| struct_members var_decl { $1->push_back(shared_ptr<NVariableDeclaration>($<var_decl>2)); }
+struct_members : /* blank */ { $$ = NEW(VariableList)(); }
+				| var_decl { $$ = NEW(VariableList)(); APPEND($$, $<var_decl>1); }
+				| struct_members var_decl { APPEND($1, $<var_decl>2); }
 
 %%
\ No newline at end of file
@@ -1,37 +1,171 @@
 #include <iostream>
 #include <fstream>
+#include <llvm/Pass.h>
+#include <llvm/Support/FileSystem.h>
+#include "ASTDump.h"
+#include "ASTFile.h"
+#include "ASTPass.h"
 #include "ASTNodes.h"
 #include "CodeGen.h"
 #include "ObjGen.h"
+#include "JIT.h"
+#include "Server.h"
+#include "Driver.h"
+#include "FunctionCache.h"
+#include "Options.h"
+#include "Parser.h"
+#include "Profile.h"
+
+//-dump-tokens and -lex-only, the scanner alone over every input
+static int scanInputs(const CompilerOptions& options){
+    std::vector<std::string> inputs = options.inputs;
+    if( inputs.empty() ){
+        inputs.push_back("");
+    }
+    for(auto& input: inputs){
+        std::string readError;
+        std::unique_ptr<SourceBuffer> source = input.empty() ? SourceBuffer::fromStdin(readError) : SourceBuffer::fromFile(input, readError);
+        if( !source ){
+            std::cerr << (input.empty() ? "stdin" : input) << ": cannot read: " << readError << std::endl;
+            return 1;
+        }
+        PhaseTimer timer("lex");
+        scanTokens(*source, options.lexer, options.dumpTokens);
+    }
+    return 0;
+}
+
+//-ast-dump, the tree of every input written to stdout as it is walked
+static int dumpInputs(const CompilerOptions& options){
+    std::vector<std::string> inputs = options.inputs;
+    if( inputs.empty() ){
+        inputs.push_back("");
+    }
+    for(auto& input: inputs){
+        std::string name = input.empty() ? "stdin" : input;
+        std::string error;
+        std::unique_ptr<SourceBuffer> source = input.empty() ? SourceBuffer::fromStdin(error) : SourceBuffer::fromFile(input, error);
+        if( !source ){
+            std::cerr << name << ": cannot read: " << error << std::endl;
+            return 1;
+        }
+        std::unique_ptr<ASTArena> tree = loadProgram(*source, options.lexer, error);
+        if( !tree ){
+            std::cerr << name << ": " << error << std::endl;
+            return 1;
+        }
+        PhaseTimer timer("dump ast");
+        dumpAST(*tree->root, options.astDump, llvm::outs());
+    }
+    return 0;
+}
+
+static int compile(const CompilerOptions& options){
+    if( options.dumpTokens || options.lexOnly ){
+        return scanInputs(options);
+    }
+    if( options.astDump != ASTDumpFormat::None ){
+        return dumpInputs(options);
+    }
+    if( options.daemon ){
+        return runCompileServer(options);
+    }
+
+    if( !options.inputs.empty() ){
+        if( options.jit ){
+            std::cerr << "--jit runs a single program read from stdin" << std::endl;
+            return 1;
+        }
+        if( options.wholeProgram ){
+            return compileWholeProgram(options.inputs, options, outputFileFor("", options));
+        }
+        return compileFiles(options.inputs, options);
+    }
+
+    //stdin is mapped when it is redirected from a file, the lexer scans it in place
+    std::string readError;
+    std::unique_ptr<SourceBuffer> source = SourceBuffer::fromStdin(readError);
+    if( !source ){
+        std::cerr << "cannot read stdin: " << readError << std::endl;
+        return 1;
+    }
+
+    //Use the token stream to build a AST whose root is programBlock,
+    //or load the tree directly when stdin holds a binary AST
+    std::string loadError;
+    std::unique_ptr<ASTArena> tree = loadProgram(*source, options.lexer, loadError);
+    if( !tree ){
+        if( isASTFile(*source) )
+            std::cerr << "stdin: " << loadError << std::endl;
+        return 1;
+    }
+    NBlock* programBlock = tree->root;
+
+    if( options.emit == OutputKind::AST ){
+        std::error_code errorCode;
+        raw_fd_ostream dest(outputFileFor("", options), errorCode, sys::fs::F_None);
+        if( errorCode ){
+            std::cerr << outputFileFor("", options) << ": " << errorCode.message() << std::endl;
+            return 1;
+        }
+        writeASTFile(*programBlock, dest);
+        return 0;
+    }
+    runASTPasses(*tree, options);
 
-extern shared_ptr<NBlock> programBlock;
-extern int yyparse();
-int main(int argc, char **argv) {
-    //Use the token stream to build a AST whose root is programBlock
-    yyparse();
-    
-    #ifdef PRINT_AND_JOSONGEN
-        programBlock->print("--");
-        auto root = programBlock->jsonGen();
-    #endif
-    
     //innitial the llvm context
     CodeGenContext context;
+    context.llvmContext.setDiscardValueNames(options.discardValueNames);
+    context.ssaLocals = options.ssaLocals;
+    if( !options.cacheDir.empty() ){
+        //only the functions changed since the last build are generated and optimized
+        doInit();
+        FunctionCache cache(options.cacheDir);
+        std::unique_ptr<TargetMachine> targetMachine(createTargetMachine(options));
+        bool succeeded = targetMachine && cache.generateCode(*programBlock, context, targetMachine.get(), options);
+        if( succeeded ){
+            std::error_code errorCode;
+            raw_fd_ostream dest(outputFileFor("", options), errorCode, sys::fs::F_None);
+            succeeded = !errorCode && emitOutput(*context.theModule, targetMachine.get(), options.emit, dest);
+        }
+        cache.printStats();
+        return succeeded ? 0 : 1;
+    }
     //Use the root Node of the AST to do the code generation
-    context.generateCode(*programBlock);
-    //Output the target
-    ObjGen(context);
+    {
+        PhaseTimer timer("codegen");
+        context.generateCode(*programBlock);
+    }
+    //Run the program in process, its main's result becomes our exit code
+    if( options.jit ){
+        return runJIT(context, options);
+    }
+    //Output the target, an object file unless -S/-emit-llvm/-emit-bc asked otherwise
+    return ObjGen(context, options, outputFileFor("", options)) ? 0 : 1;
+}
 
-#ifdef PRINT_AND_JOSONGEN
-    std::string outPutJsonFile = "visual/Tree.json";
-    std::ofstream astJson(outPutJsonFile);
-    if( astJson.is_open() ){
-        astJson << root;
-        astJson.close();
-        std::cout << "json file output" << outPutJsonFile << std::endl;
+int main(int argc, char **argv) {
+    CompilerOptions options;
+    if( !parseOptions(argc, argv, options) ){
+        printUsage(argv[0]);
+        return 1;
     }
-#endif
 
-    return 0;
+    bool report = options.timeReport || options.memReport;
+    if( report || !options.timeTrace.empty() ){
+        enableProfiling(!options.timeTrace.empty());
+    }
+    //LLVM adds its own per pass timing table at exit
+    llvm::TimePassesIsEnabled = options.timeReport;
+
+    int status = compile(options);
+
+    if( report ){
+        printProfileReport(llvm::errs(), options.timeReport, options.memReport);
+    }
+    if( !options.timeTrace.empty() && !writeTrace(options.timeTrace) ){
+        status = 1;
+    }
+    return status;
 }
 
@@ -0,0 +1,46 @@
+# Check the stack slots of every function in a module printed by -emit-llvm:
+# all allocas sit in the entry block, and each llvm.lifetime.start has its
+# llvm.lifetime.end. Prints what is wrong and fails, for make regress.
+/^define / {
+    function_name = $0
+    sub(/^[^@]*/, "", function_name)
+    sub(/\(.*/, "", function_name)
+    instructions = 0
+    entry = 1
+    starts = 0
+    ends = 0
+    next
+}
+function_name == "" {
+    next
+}
+/^}/ {
+    if( starts != ends ){
+        print function_name ": " starts " lifetime.start, " ends " lifetime.end"
+        failed = 1
+    }
+    function_name = ""
+    next
+}
+# a block label, the entry block only has one before its first instruction
+/^[^ ]/ {
+    if( instructions > 0 )
+        entry = 0
+    next
+}
+/^ / {
+    instructions++
+}
+/ = alloca / && !entry {
+    print function_name ": alloca outside the entry block: " $0
+    failed = 1
+}
+/call void @llvm\.lifetime\.start/ {
+    starts++
+}
+/call void @llvm\.lifetime\.end/ {
+    ends++
+}
+END {
+    exit failed
+}
@@ -5,9 +5,4 @@
 #include "CodeGen.h"
 #include "ASTNodes.h"
 
-extern int yyparse();
-extern NBlock* programBlock;
-
-
-
 #endif